@@ -2,12 +2,32 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <time.h>
+#include <elf.h>
 
 #define MAXLEN 100 // 最大记号长度
 #define KEYNUM 8 // 关键字个数
-#define SYMNUM 50 // 符号表大小
-#define QUADNUM 100 // 四元式序列大小
+#define SYMNUM 50 // 符号表初始容量（不足时自动扩容）
+#define QUADNUM 100 // 四元式序列初始容量（不足时自动扩容）
+#define LABELNUM 50 // 标号表初始容量（不足时自动扩容）
 #define CODESIZE 1000 // 目标代码大小
+#define MAXTHREADS 64 // 代码生成最大线程数
+#define PARTSPERTHREAD 4 // 每个线程平均分到的四元式分区数
+#define PARALLELMIN 256 // 四元式数目少于该值时不启用并行代码生成
+#define STREAMWINDOW 64 // 流式模式下四元式窗口大小，顶层语句结束后窗口中累积到该数目即输出
+#define TOKENNUM 1024 // 记号流初始容量（不足时自动扩容）
+#define INTERNNUM 1024 // 驻留表初始容量（不足时自动扩容）
+#define LEXCHUNKMIN 65536 // 并行分词时每块的最小字节数（源程序较小时串行分词）
+#define MAXARGS 4 // 函数参数的最大个数（通过$a0~$a3传递）
+#define TOPFRAME 8 // 顶层代码栈帧大小（保存返回地址，保持8字节对齐）
+#define INLINECOST 16 // 函数体（不计参数和变量声明）四元式数目不超过该值的叶函数在调用处内联展开
+#define MAXARRAY 32767 // 数组的最大元素个数（越界检查使用16位立即数）
+#define MACHINEOPNUM 25 // 目标代码中使用的机器指令个数
+#define STACKSIZE (1 << 20) // 模拟执行时栈的大小（字节）
+#define STAGENUM 5 // -time-passes计时的编译阶段个数
+#define SIMSTEPS 1000000000LL // 模拟执行的最大指令数，超过时认为是死循环
 
 // 记号类别
 enum TokenType {
@@ -19,14 +39,86 @@ enum TokenType {
     ERR // 错误
 };
 
+// 记号子类别，语法分析器只比较子类别而不比较记号字符串
+enum TokenSubtype {
+    KW_INT, KW_CHAR, KW_IF, KW_ELSE, KW_WHILE, KW_RETURN, KW_MAIN, KW_VOID, // 关键字，顺序与关键字表一致
+    OP_PLUS, OP_MINUS, OP_MUL, OP_DIV, OP_MOD, OP_LT, OP_GT, OP_ASSIGN, OP_NOT, OP_AND, OP_OR, // 单字符运算符，顺序与运算符集合一致
+    OP_LE, OP_GE, OP_EQ, OP_NE, OP_ANDAND, OP_OROR, // 双字符运算符
+    DEL_LPAREN, DEL_RPAREN, DEL_COMMA, DEL_SEMI, DEL_LBRACE, DEL_RBRACE, DEL_LBRACKET, DEL_RBRACKET, // 界符，顺序与界符集合一致
+    SUB_NONE, // 标识符和数字常量没有子类别
+    SUB_EOF // 文件结束
+};
+
 // 关键字表
 char *keywords[KEYNUM] = {"int", "char", "if", "else", "while", "return", "main", "void"};
 
+// 记号子类别对应的字符串，用于生成四元式的操作符
+char *subNames[] = {"int", "char", "if", "else", "while", "return", "main", "void",
+                    "+", "-", "*", "/", "%", "<", ">", "=", "!", "&", "|",
+                    "<=", ">=", "==", "!=", "&&", "||",
+                    "(", ")", ",", ";", "{", "}", "[", "]",
+                    "", "EOF"};
+
+// 符号种类
+enum SymbolKind {
+    SYM_VAR, // 变量
+    SYM_PARAM, // 函数参数
+    SYM_FUNC // 函数
+};
+
+// 操作数种类
+enum OperandKind {
+    OPD_CONST, // 数字常量
+    OPD_TEMP, // 临时变量
+    OPD_VAR // 变量（在符号表中）
+};
+
+// 机器指令，顺序与机器指令表一致
+enum MachineOp {
+    M_LW, M_SW, M_LI, M_MOVE, M_ADDU, M_SUBU, M_MUL, M_DIV, M_REM, M_ADDIU, M_SLTI, M_SLTIU,
+    M_SLL, M_SRA, M_SRL, M_TEQ, M_BEQ, M_BNE, M_BLT, M_BLE, M_BGT, M_BGE, M_J, M_JAL, M_JR
+};
+
+// 代码生成用到的寄存器编号，与寄存器名表的下标一致
+enum Register {
+    R_ZERO = 0, R_V0 = 2, R_A0 = 4, R_T0 = 8, R_T1 = 9, R_T2 = 10, R_GP = 28, R_SP = 29, R_FP = 30, R_RA = 31
+};
+
+// 编译阶段，用于-time-passes分阶段计时
+enum Stage {
+    ST_LEX, // 预先分词（默认模式下分词与语法分析交替进行，计入语法分析）
+    ST_PARSE, // 语法分析（流式模式下不含输出窗口的时间）
+    ST_SEMA, // 语义分析
+    ST_CODEGEN, // 代码生成
+    ST_OBJECT // 编码并输出目标文件
+};
+
+// 编译阶段名表，顺序与enum Stage一致
+char *stageNames[STAGENUM] = {"lex", "parse", "sema", "codegen", "object"};
+
+// 机器指令表
+char *machineOps[MACHINEOPNUM] = {"LW", "SW", "LI", "MOVE", "ADDU", "SUBU", "MUL", "DIV", "REM", "ADDIU", "SLTI", "SLTIU",
+                                  "SLL", "SRA", "SRL", "TEQ", "BEQ", "BNE", "BLT", "BLE", "BGT", "BGE", "J", "JAL", "JR"};
+
+// 寄存器名表，下标为寄存器编号
+char *regNames[32] = {"$zero", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
+                      "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+                      "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+                      "$t8", "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra"};
+
 // 符号表项结构体
 struct Symbol {
-    char name[MAXLEN]; // 符号名
+    char name[MAXLEN]; // 符号名（函数的参数和局部变量为“函数名.变量名”）
     enum TokenType type; // 符号类别（标识符或关键字）
     int value; // 符号值（数字常量或变量地址）
+    int address; // 变量地址（全局变量相对于$gp，参数和局部变量相对于$fp）
+    enum SymbolKind kind; // 符号种类
+    int scope; // 所属函数在符号表中的位置（-1表示全局）
+    int nparams; // 函数的参数个数
+    int frame; // 函数栈帧中参数和局部变量所占的字节数
+    int body; // 函数体在内联表中的位置（-1表示不可内联）
+    int size; // 数组的元素个数（0表示标量）
+    enum TokenSubtype ret; // 函数的返回类型（KW_VOID表示没有返回值）
 };
 
 // 四元式结构体
@@ -37,17 +129,185 @@ struct Quadruple {
     char result[MAXLEN]; // 结果
 };
 
+// 临时变量信息结构体，临时变量不在符号表中，按编号存放在临时变量表中
+struct TempInfo {
+    int def; // 定义位置（-1表示未定义）
+    int use; // 最后一次使用的位置
+    int uses; // 使用次数
+    int inreg; // 是否留在寄存器$t2中（只在紧随定义的下一个四元式中使用一次），不分配存储空间
+    int address; // 地址（顶层的临时变量相对于$gp，函数中的临时变量相对于$fp）
+    int scope; // 所属函数在符号表中的位置（-1表示顶层）
+};
+
+// 标号表项结构体
+struct Label {
+    char name[MAXLEN]; // 标号名
+    int quadpos; // 标号所指向的四元式位置
+};
+
+// 目标代码缓冲区结构体
+struct CodeBuffer {
+    char *data; // 缓冲区内容
+    int len; // 已使用的长度
+    int cap; // 缓冲区容量
+};
+
+// 记号流结构体，整个源程序预先分词后按结构数组形式存放
+struct TokenStream {
+    unsigned char *kind; // 记号类别（enum TokenType）
+    unsigned char *sub; // 记号子类别（enum TokenSubtype）
+    int *offset; // 记号在源程序中的起始位置
+    int *length; // 记号长度
+    int *id; // 标识符和数字常量的驻留编号（其余记号为-1）
+    int num; // 记号个数
+    int cap; // 记号流容量
+};
+
+// 字符串驻留表结构体，相同的标识符或数字常量共享同一个编号
+struct InternTable {
+    char **names; // 编号对应的字符串
+    int *sym; // 编号对应的符号表位置（-1表示未声明）
+    unsigned *hash; // 编号对应的字符串的哈希值（扩容和合并驻留表时不必重新计算）
+    int num; // 已驻留的字符串个数
+    int cap; // names、sym和hash数组的容量
+    int *slots; // 哈希槽，存放编号（-1表示空槽）
+    int slotcap; // 哈希槽个数（2的幂）
+};
+
+// 可内联函数体结构体，保存函数定义时的四元式（不含FUNC和ENDF）及其中的标号
+struct InlineBody {
+    struct Quadruple *quads; // 函数体四元式
+    int quadnum; // 函数体四元式个数
+    struct Label *labels; // 函数体中的标号（位置相对于函数体开头）
+    int labelnum; // 函数体中的标号个数
+    int valued; // 是否每条路径都返回值（以带返回值的RET结尾，没有不带返回值的RET，也没有标号指向函数体末尾）
+};
+
+// 内联重命名表项结构体
+struct Rename {
+    char from[MAXLEN]; // 被调函数中的名字
+    char to[MAXLEN]; // 展开副本中的新名字
+};
+
+// 优化遍结构体，优化遍管理器按注册顺序对四元式序列依次运行已启用的优化遍
+struct Pass {
+    char *name; // 优化遍名（用于命令行选项）
+    int level; // 启用该遍的最低优化级别
+    int (*run)(); // 优化遍函数，返回对四元式序列的改动次数
+    int disabled; // 是否在命令行中被关闭
+    int dumpBefore; // 运行前是否打印四元式序列
+    int dumpAfter; // 运行后是否打印四元式序列
+    int runs; // 运行次数（流式模式下每个窗口运行一次）
+    int changes; // 累计改动次数
+    double seconds; // 累计运行时间（秒）
+};
+
+// 机器指令结构体，由代码生成直接产生，汇编形式的目标代码由它格式化得到
+struct Instr {
+    enum MachineOp op; // 机器指令
+    int r[3]; // 寄存器操作数的编号，按在汇编形式中出现的顺序（-1表示没有）
+    int imm; // 立即数、移位量或偏移量
+    int data; // imm是否为全局数据区中的地址（目标文件中需要GP相对重定位）
+    char label[MAXLEN]; // 跳转目标的标号或函数名（空串表示没有）
+    int ref; // 跳转目标标号在标号表中的序号
+    int target; // 跳转目标的指令序号
+};
+
+// 目标程序结构体
+struct Program {
+    struct Instr *code; // 指令数组
+    int num; // 指令个数
+    int cap; // 指令数组容量
+    struct Label *labels; // 标号表（quadpos为标号所指的指令序号）
+    int labelnum; // 标号个数
+    int labelcap; // 标号表容量
+};
+
+// 代码生成分区结构体，每个分区是由若干完整基本块组成的连续四元式区间
+struct CodePartition {
+    int begin; // 分区起始四元式位置
+    int end; // 分区结束四元式位置（不含）
+    int label; // 分区内第一个标号在标号表中的位置
+    struct Program code; // 分区的线程局部目标程序
+    struct CodeBuffer text; // 分区的汇编形式目标代码（需要输出汇编形式时由工作线程生成）
+};
+
+// 重定位项结构体
+struct Reloc {
+    int type; // 重定位类型：J和JAL为R_MIPS_26，访问全局数据区的LW和SW为R_MIPS_GPREL16
+    int offset; // 需要重定位的指令在代码段中的字节偏移量
+    int symbol; // 重定位所引用的符号在ELF符号表中的序号
+};
+
+// 目标文件代码段结构体，由目标程序编码得到
+struct ObjectCode {
+    unsigned *words; // 机器指令字数组
+    int num; // 机器指令字个数
+    int cap; // 机器指令字数组容量
+    struct Reloc *relocs; // 重定位表
+    int relocnum; // 重定位项个数
+    int reloccap; // 重定位表容量
+    int datasym; // 全局数据区符号在ELF符号表中的序号
+};
+
+// 作用域项结构体，记录进入函数时被局部符号遮盖的驻留编号，以便离开函数时恢复
+struct ScopeEntry {
+    int id; // 驻留编号
+    int old; // 被遮盖的符号表位置
+};
+
 // 全局变量声明
 char ch; // 当前字符
 char token[MAXLEN]; // 当前记号
 int pos = 0; // 记号位置指针
 enum TokenType type; // 记号类别
+enum TokenSubtype subtype; // 记号子类别
+int tokid = -1; // 当前记号的驻留编号（标识符和数字常量，其余为-1）
+
+struct InternTable interns = {NULL, NULL, NULL, 0, 0, NULL, 0}; // 标识符和数字常量驻留表
+int pretokenized = 0; // 是否为预先分词模式（先把整个源程序分词为记号流，语法分析器再逐个取用）
+struct TokenStream tokens = {NULL, NULL, NULL, NULL, NULL, 0, 0}; // 预先分词得到的记号流
+int tokpos = 0; // 记号流中下一个记号的位置
 
-struct Symbol symtab[SYMNUM]; // 符号表数组
+struct Symbol *symtab = NULL; // 符号表数组
 int symnum = 0; // 符号表大小
+int symcap = 0; // 符号表容量
+struct InternTable symnames = {NULL, NULL, NULL, 0, 0, NULL, 0}; // 符号名散列表，sym为符号名对应的符号表位置
 
-struct Quadruple quadtab[QUADNUM]; // 四元式序列数组
+int curFunc = -1; // 正在分析的函数在符号表中的位置（-1表示不在函数中）
+int nesting = 0; // 语句嵌套深度（流式模式下只在顶层语句结束后输出窗口）
+struct ScopeEntry *scopetab = NULL; // 作用域表数组
+int scopenum = 0; // 作用域表大小
+int scopecap = 0; // 作用域表容量
+
+struct InlineBody *inltab = NULL; // 内联表数组
+int inlnum = 0; // 内联表大小
+struct InternTable carried = {NULL, NULL, NULL, 0, 0, NULL, 0}; // 流式模式下已输出部分末尾的直线代码中被赋值的标量变量，sym为1表示最后一次赋的是常量
+
+struct Quadruple *quadtab = NULL; // 四元式序列数组
 int quadnum = 0; // 四元式序列大小
+int quadcap = 0; // 四元式序列容量
+
+struct Label *labeltab = NULL; // 标号表数组，按四元式位置递增排列
+int labelnum = 0; // 标号表大小
+int labelcap = 0; // 标号表容量
+
+struct TempInfo *temptab = NULL; // 临时变量表数组，第k项对应临时变量t.(tempbase+k)
+int tempbase = 0; // 临时变量表中第一个临时变量的编号
+int tempnum = 0; // 临时变量表大小
+int tempcap = 0; // 临时变量表容量
+
+int offset = 0; // 变量地址偏移量
+int flag = 0; // 条件标志位
+
+int codegenThreads = 1; // 代码生成线程数（1表示串行生成）
+int lexThreads = 1; // 预先分词模式下的分词线程数（1表示串行分词）
+
+int streaming = 0; // 是否为流式模式（每条顶层语句的标号确定后立即生成并输出目标代码）
+FILE *streamOut = NULL; // 流式模式下的目标代码文件指针
+struct CodeBuffer streamBuf = {NULL, 0, 0}; // 流式模式下反复使用的汇编形式目标代码缓冲区
+struct Program streamCode = {NULL, 0, 0, NULL, 0, 0}; // 流式模式下反复使用的窗口目标程序
+struct Program target = {NULL, 0, 0, NULL, 0, 0}; // 整个目标程序
 
 char code[CODESIZE]; // 目标代码字符串
 int codepos = 0; // 目标代码位置指针
@@ -55,21 +315,40 @@ int codepos = 0; // 目标代码位置指针
 FILE *fp; // 源程序文件指针
 
 // 函数声明
-void lexicalAnalysis(); // 词法分析函数，获取下一个记号并存入全局变量token和type中
+void lexicalAnalysis(); // 词法分析函数，获取下一个记号并存入全局变量token、type、subtype和tokid中
+int lexRange(const char *src, int begin, int end, struct TokenStream *ts, struct InternTable *it); // 对源程序的一段进行词法分析，把记号追加到记号流中，返回出错位置（-1表示没有出错）
+void lexError(const char *src, int pos); // 报告分词时在位置pos处发现的错误
+void lexParallel(const char *src, int size, int nthreads); // 把整个源程序分词到全局记号流中，源程序较大时分块并行分词
+void *lexWorker(void *arg); // 分词工作线程函数
+void *resolveWorker(void *arg); // 查找工作线程函数，确定块内每个名字首次出现的块
+void *spliceWorker(void *arg); // 记号流拼接工作线程函数
+void pushToken(struct TokenStream *ts, enum TokenType kind, enum TokenSubtype sub, int offset, int length, int id); // 把一个记号追加到记号流中
+unsigned hashText(const char *text, int len); // 计算字符串的哈希值
+int internToken(struct InternTable *it, const char *text, int len); // 驻留字符串，返回其编号
+int findInterned(struct InternTable *it, const char *text, int len); // 查找字符串的驻留编号，不存在则返回-1
+int findHashed(struct InternTable *it, const char *text, int len, unsigned h); // 按已知的哈希值查找字符串的驻留编号，不存在则返回-1
+int addInterned(struct InternTable *it, char *name, unsigned h); // 把尚未驻留的字符串连同其哈希值加入驻留表，返回其编号
+void freeInterned(struct InternTable *it); // 释放驻留表
+char *readSource(FILE *fp, int *size); // 读入整个源程序文件
 void syntaxAnalysis(); // 语法分析函数，分析源程序的语法结构并生成四元式序列
 void semanticAnalysis(); // 语义分析函数，检查源程序的语义正确性并填充符号表和四元式序列中的值和地址信息
-void codeGeneration(); // 目标代码生成函数，根据四元式序列和符号表生成目标代码并输出到文件中
+void semanticRange(int begin, int end); // 对[begin, end)区间内的四元式进行语义检查和处理
+void flushQuads(int final); // 流式模式下对四元式窗口进行语义分析和代码生成并立即输出，然后清空窗口
+void codeGeneration(); // 目标代码生成函数，根据四元式序列和符号表生成目标程序，需要时输出汇编形式的目标代码
 
 void program(); // 程序分析函数，对应产生式<程序> ::= <声明序列><语句序列>
 void declarationList(); // 声明序列分析函数，对应产生式<声明序列> ::= <声明><声明序列>|ε
-void declaration(); // 声明分析函数，对应产生式<声明> ::= <类型><标识符>;
-void type(); // 类型分析函数，对应产生式<类型> ::= int|char|void
+void declaration(); // 声明分析函数，对应产生式<声明> ::= <类型><标识符>;|<类型><标识符>[<常量>];|<函数定义>
+void functionDefinition(enum TokenSubtype ret, int id); // 函数定义分析函数，对应产生式<函数定义> ::= <类型><标识符>(<参数表>){<声明序列><语句序列>}
+void typeSpec(); // 类型分析函数，对应产生式<类型> ::= int|char|void
 void statementList(); // 语句序列分析函数，对应产生式<语句序列> ::= <语句><语句序列>|ε
-void statement(); // 语句分析函数，对应产生式<语句> ::= <赋值语句>|<条件语句>|<循环语句>|<返回语句>
-void assignStatement(); // 赋值语句分析函数，对应产生式<赋值语句> ::= <标识符>=<表达式>;
+void statement(); // 语句分析函数，对应产生式<语句> ::= <赋值语句>|<调用语句>|<条件语句>|<循环语句>|<返回语句>|<复合语句>
+void assignStatement(); // 赋值语句分析函数，对应产生式<赋值语句> ::= <标识符>=<表达式>;|<标识符>[<表达式>]=<表达式>;
 void expression(char *place); // 表达式分析函数，对应产生式<表达式> ::= <项>{+<项>|-<项>}，参数place用于存储表达式的结果位置（临时变量或标识符）
 void term(char *place); // 项分析函数，对应产生式<项> ::= <因子>{*<因子>|/<因子>|%<因子>}，参数place用于存储项的结果位置（临时变量或标识符）
-void factor(char *place); // 因子分析函数，对应产生式<因子> ::= <标识符>|<常量>|(<表达式>)，参数place用于存储因子的结果位置（临时变量或标识符）
+void factor(char *place); // 因子分析函数，对应产生式<因子> ::= <标识符>|<标识符>[<表达式>]|<常量>|(<表达式>)|<函数调用>，参数place用于存储因子的结果位置（临时变量或标识符）
+void subscript(int array, char *place); // 下标分析函数，对应产生式<下标> ::= [<表达式>]，参数place用于存储下标的结果位置（临时变量或标识符）
+void call(char *place); // 函数调用分析函数，对应产生式<函数调用> ::= <标识符>(<实参表>)，参数place用于存储返回值的位置（为空串时丢弃返回值）
 void conditionStatement(); // 条件语句分析函数，对应产生式<条件语句> ::= if(<条件>)<语句>{else<语句>}
 void condition(char *trueLabel, char *falseLabel); // 条件分析函数，对应产生式<条件> ::= <表达式><关系运算符><表达式>，参数trueLabel和falseLabel用于存储条件为真和为假时的跳转标号
 void loopStatement(); // 循环语句分析函数，对应产生式<循环语句> ::= while(<条件>)<语句>
@@ -77,12 +356,37 @@ void returnStatement(); // 返回语句分析函数，对应产生式<返回语
 
 void error(char *msg); // 错误处理函数，打印错误信息并退出程序
 int isKeyword(char *token); // 判断是否为关键字，是则返回其序号，否则返回-1
+int keywordIndex(const char *text, int len); // 判断长度为len的字符串是否为关键字，是则返回其序号，否则返回-1
+int doubleOp(char ch, char next); // 判断是否为双字符运算符，是则返回其子类别，否则返回-1
+int isTypeKeyword(); // 判断当前记号是否为类型关键字
+int isRelOp(); // 判断当前记号是否为关系运算符
 int isLetter(char ch); // 判断是否为字母或下划线
 int isOperator(char ch); // 判断是否为运算符，是则返回其序号，否则返回-1
 int isDelimiter(char ch); // 判断是否为界符，是则返回其序号，否则返回-1
 void printToken(enum TokenType type, char *token); // 打印记号信息
 int lookupSymbol(char *name); // 查找符号表，返回符号在表中的位置，如果不存在则返回-1
+int lookupId(int id); // 按驻留编号查找符号表，返回符号在表中的位置，如果不存在则返回-1
 void insertSymbol(char *name, enum TokenType type, int value); // 插入符号表，如果已存在则报错
+void appendSymbol(char *name, enum TokenType type, int value); // 把符号追加到符号表末尾，不检查重复
+void insertSymbolId(int id, enum TokenType type, int value); // 按驻留编号插入符号表，如果已存在则报错；在函数中插入局部符号
+void leaveScope(); // 离开函数，恢复被局部符号遮盖的全局符号
+void saveInlineBody(int func, int begin); // 保存可内联的函数体
+int canInline(int callee, char *result); // 判断对函数的调用能否内联展开
+int inlineCalls(); // 内联展开四元式序列中对小的叶函数的调用，返回展开的调用个数
+void expandInline(int callee, int caller, struct Quadruple *args, int nargs, char *result); // 在当前位置展开一次函数调用
+char *renameLookup(struct Rename *map, int *mapnum, char *name, char *(*create)()); // 在内联重命名表中查找或登记名字
+char *renameOperand(struct Rename *map, int *mapnum, char *name); // 对内联函数体中的操作数重命名
+int isTemp(char *name); // 判断操作数是否为临时变量
+int tempNumber(char *name); // 返回临时变量的编号
+int isConstant(char *name); // 判断操作数是否为数字常量
+int eliminateBoundsChecks(); // 删除while循环中可以证明不会越界的越界检查，返回删除的四元式个数
+void removeQuads(char *dead); // 删除四元式序列中标记为dead的四元式，并调整标号位置
+int labelPosition(struct InternTable *labels, char *name); // 返回标号所指的四元式位置，不在表中时返回-1
+int carriedConstant(char *var); // 判断流式模式下已输出部分末尾的直线代码中最后一次给变量赋的是否为常量
+void carryAssigns(); // 记录窗口末尾的直线代码中各变量的最后一次赋值，供下一个窗口删除越界检查使用
+int returnsCall(int i); // 判断四元式是否为直接返回前一个调用的结果
+int baseReg(int index); // 返回变量寻址所用的基址寄存器
+int frameSize(int func); // 返回函数的栈帧大小
 void updateSymbol(int index, int value); // 更新符号表中的值
 char *newTemp(); // 生成一个新的临时变量名
 char *newLabel(); // 生成一个新的标号名
@@ -94,69 +398,157 @@ void printSymbol(struct Symbol sym); // 打印符号表项信息
 void printSymbolList(); // 打印符号表信息
 void emitCode(char *code); // 生成目标代码并加入到目标代码字符串中
 void printCode(); // 打印目标代码信息
-
-// 词法分析函数，获取下一个记号并存入全局变量token和type中
+void bufPrintf(struct CodeBuffer *buf, const char *fmt, ...); // 按格式生成目标代码并追加到缓冲区中
+int isBranch(struct Quadruple quad); // 判断四元式是否为跳转或返回（基本块的结束）
+int findLabel(int quadpos); // 返回标号表中第一个位置不小于quadpos的标号序号
+void genQuad(int i, struct Program *code); // 为第i个四元式生成目标代码
+void genTopEntry(struct Program *code); // 生成顶层代码的入口
+void genTopExit(struct Program *code); // 生成顶层代码的返回
+void genFuncExit(char *name, struct Program *code); // 生成函数的返回
+void emitInstr(struct Program *code, enum MachineOp op, int r0, int r1, int r2, int imm, const char *label); // 在目标程序末尾追加一条指令
+void emitMemory(struct Program *code, enum MachineOp op, int reg, int offset, int base, int data); // 追加一条LW或SW指令
+void emitLabel(struct Program *code, const char *name); // 在目标程序末尾追加一个标号
+void appendProgram(struct Program *dst, struct Program *src); // 把一段目标程序追加到另一段末尾
+void resolveLabels(struct Program *prog); // 把跳转指令的目标标号解析为标号序号和指令序号
+void formatInstr(struct Instr *in, struct CodeBuffer *buf); // 按汇编形式输出一条指令
+void formatProgram(struct Program *code, struct CodeBuffer *buf); // 按汇编形式输出一段目标程序及其标号
+void writeListing(const char *path, struct CodeBuffer *buf); // 把汇编形式的目标代码写入文件
+void scanTemps(int begin, int end); // 统计临时变量的定义和使用位置，决定哪些临时变量留在寄存器中
+void allocTemp(char *name, int func); // 为临时变量分配空间
+void checkOperand(char *name); // 检查作为操作数使用的名字
+void checkTarget(char *name); // 检查被赋值的名字
+enum OperandKind operandKind(char *name); // 返回操作数的种类
+int operandAddress(char *name, int *base); // 返回变量或临时变量的地址和基址寄存器
+int inRegister(char *name); // 判断临时变量是否留在寄存器$t2中
+int immediate(char *name, int *value); // 判断操作数是否为能放进立即数字段的常量
+int powerOfTwo(char *name); // 如果操作数是2的幂的常量，返回其对数，否则返回-1
+int useOperand(char *name, int scratch, struct Program *code); // 把操作数的值放到寄存器中并返回寄存器编号
+void defineResult(char *name, int reg, struct Program *code); // 把寄存器中的值存入结果位置
+int genRange(int begin, int end, int label, struct Program *code); // 为一段四元式及其标号生成目标代码，返回下一个待输出标号的序号
+int partitionQuads(struct CodePartition *parts, int maxparts); // 在基本块边界处把四元式序列划分为若干分区，返回分区个数
+void *codegenWorker(void *arg); // 代码生成工作线程函数
+int findPass(char *name); // 按名字查找优化遍，返回其在优化遍表中的位置，如果不存在则报错
+void runPasses(); // 按优化级别依次运行优化遍表中已启用的优化遍
+void printPassTimes(); // 打印各优化遍的运行次数、改动次数和运行时间，以及各编译阶段的运行时间
+double wallTime(); // 返回当前的单调时钟时间（秒）
+int memoryWord(int address, int size); // 检查模拟执行时访问的内存地址，返回对应的字序号
+long long simulate(struct Program *prog, int data, int *result); // 模拟执行目标代码，返回执行的指令数
+int totalFrameSize(); // 返回所有函数栈帧大小之和
+void bufBytes(struct CodeBuffer *buf, const void *data, int n); // 把字节序列追加到缓冲区中
+void bufWord(struct CodeBuffer *buf, unsigned word); // 按大端字节序把一个32位字追加到缓冲区中
+void bufHalf(struct CodeBuffer *buf, unsigned half); // 按大端字节序把一个16位半字追加到缓冲区中
+void emitWord(struct ObjectCode *obj, unsigned word); // 把一个机器指令字追加到代码段中
+unsigned encodeR(int rs, int rt, int rd, int shamt, int funct); // 编码R型指令
+unsigned encodeI(int opcode, int rs, int rt, int imm); // 编码I型指令
+int fitsImm16(int value); // 判断整数能否放进16位有符号立即数字段
+void encodeLoadImm(int reg, int value, struct ObjectCode *obj); // 把32位常量装入寄存器
+void encodeBranch(int opcode, int rs, int rt, int target, int *pos, struct ObjectCode *obj); // 编码条件跳转指令及其延迟槽
+void encodeInstr(struct Program *prog, int i, int *pos, int *symbols, struct ObjectCode *obj); // 把一条指令编码为机器指令字
+void bufSection(struct CodeBuffer *buf, int name, int type, int flags, int offset, int size, int link, int info, int align, int entsize); // 写一个ELF32节头
+void bufSymbol(struct CodeBuffer *buf, int name, int value, int size, int bind, int type, int shndx); // 写一个ELF32符号表项
+void addReloc(struct ObjectCode *obj, int type, int symbol); // 为代码段中下一个机器指令字登记一个重定位项
+void writeObject(const char *path, struct Program *prog); // 把目标程序编码为机器指令，写出可重定位的ELF32目标文件
+
+// 优化遍表，按运行顺序注册（内联展开之后再删除越界检查，展开后的循环也能被处理）
+struct Pass passes[] = {
+    {"inline", 2, inlineCalls, 0, 0, 0, 0, 0, 0.0}, // 内联展开小的叶函数
+    {"bounds", 1, eliminateBoundsChecks, 0, 0, 0, 0, 0, 0.0} // 删除循环中不会越界的越界检查
+};
+int passnum = sizeof(passes) / sizeof(passes[0]); // 优化遍个数
+int optLevel = 2; // 优化级别（0表示不运行任何优化遍）
+int timePasses = 0; // 是否打印各优化遍的运行时间
+double stageSeconds[STAGENUM] = {0.0}; // 各编译阶段的运行时间（秒，优化遍单独计时）
+int showStats = 0; // 是否打印目标代码的静态指令数、栈帧大小和全局数据区大小
+int runTarget = 0; // 是否模拟执行目标代码并打印动态指令数和返回值
+int emitObject = 0; // 是否输出ELF目标文件target.o
+int keepListing = 0; // 是否输出汇编形式的目标代码target.txt（不输出目标文件时总是输出，输出目标文件时由-listing要求）
+
+// 词法分析函数，获取下一个记号并存入全局变量token、type、subtype和tokid中
 void lexicalAnalysis() {
+    if (pretokenized) { // 预先分词模式：直接从记号流中取出下一个记号，不再复制和比较字符串
+        if (tokpos < tokens.num) {
+            type = (enum TokenType)tokens.kind[tokpos]; // 记号类别
+            subtype = (enum TokenSubtype)tokens.sub[tokpos]; // 记号子类别
+            tokid = tokens.id[tokpos]; // 驻留编号
+            printToken(type, tokid != -1 ? interns.names[tokid] : subNames[subtype]); // 打印记号信息（可选）
+            tokpos++;
+        } else { // 记号流结束
+            type = ERR; // 设置类别为错误（用于表示文件结束）
+            subtype = SUB_EOF;
+            tokid = -1;
+        }
+        return;
+    }
     while ((ch = fgetc(fp)) != EOF) { // 读取文件直到结束
         if (isspace(ch)) { // 跳过空白字符
             continue;
         } else if (isLetter(ch)) { // 处理标识符或关键字
             token[pos++] = ch; // 加入记号
             while (isLetter(ch = fgetc(fp)) || isdigit(ch)) { // 读取后续字符直到非字母或数字
+                if (pos == MAXLEN - 1) { // 记号过长，无法存入token、符号表和四元式（与预先分词模式的检查一致）
+                    error("Token too long");
+                }
                 token[pos++] = ch; // 加入记号
             }
             ungetc(ch, fp); // 将多读的字符退回文件流中
             token[pos] = '\0'; // 添加字符串结束标志
-            pos = 0; // 重置位置指针
 
             int index = isKeyword(token); // 判断是否为关键字
             if (index != -1) { // 是关键字
                 type = KEY; // 设置类别为关键字
-                printToken(type, token); // 打印记号信息（可选）
-                return; // 返回记号信息给语法分析器
+                subtype = (enum TokenSubtype)(KW_INT + index); // 关键字子类别与关键字表顺序一致
+                tokid = -1;
             } else { // 不是关键字
                 type = ID; // 设置类别为标识符
-                printToken(type, token); // 打印记号信息（可选）
-                return; // 返回记号信息给语法分析器
+                subtype = SUB_NONE;
+                tokid = internToken(&interns, token, pos); // 驻留标识符，语法分析器只使用编号
             }
+            pos = 0; // 重置位置指针
+            printToken(type, token); // 打印记号信息（可选）
+            return; // 返回记号信息给语法分析器
         } else if (isdigit(ch)) { // 处理数字常量
             token[pos++] = ch; // 加入记号
             while (isdigit(ch = fgetc(fp))) { // 读取后续字符直到非数字
+                if (pos == MAXLEN - 1) { // 记号过长，无法存入token、符号表和四元式（与预先分词模式的检查一致）
+                    error("Token too long");
+                }
                 token[pos++] = ch; // 加入记号
             }
             ungetc(ch, fp); // 将多读的字符退回文件流中
             token[pos] = '\0'; // 添加字符串结束标志
-            pos = 0; // 重置位置指针
 
             type = NUM; // 设置类别为数字常量
+            subtype = SUB_NONE;
+            tokid = internToken(&interns, token, pos); // 驻留数字常量，语法分析器只使用编号
+            pos = 0; // 重置位置指针
             printToken(type, token); // 打印记号信息（可选）
             return; // 返回记号信息给语法分析器
         } else if (isOperator(ch) != -1) { // 处理运算符
             token[pos++] = ch; // 加入记号
             char next = fgetc(fp); // 读取下一个字符
-            if ((ch == '<' || ch == '>' || ch == '=' || ch == '!' || ch == '&' || ch == '|') && next == ch) { // 处理双字符运算符
+            int index = doubleOp(ch, next); // 判断是否为双字符运算符
+            if (index != -1) { // 处理双字符运算符
                 token[pos++] = next; // 加入记号
-                token[pos] = '\0'; // 添加字符串结束标志
-                pos = 0; // 重置位置指针
-
-                type = OP; // 设置类别为运算符
-                printToken(type, token); // 打印记号信息（可选）
-                return; // 返回记号信息给语法分析器
+                subtype = (enum TokenSubtype)index;
             } else { // 处理单字符运算符
                 ungetc(next, fp); // 将多读的字符退回文件流中
-                token[pos] = '\0'; // 添加字符串结束标志
-                pos = 0; // 重置位置指针
-
-                type = OP; // 设置类别为运算符
-                printToken(type, token); // 打印记号信息（可选）
-                return; // 返回记号信息给语法分析器
+                subtype = (enum TokenSubtype)(OP_PLUS + isOperator(ch)); // 单字符运算符子类别与运算符集合顺序一致
             }
+            token[pos] = '\0'; // 添加字符串结束标志
+            pos = 0; // 重置位置指针
+
+            type = OP; // 设置类别为运算符
+            tokid = -1;
+            printToken(type, token); // 打印记号信息（可选）
+            return; // 返回记号信息给语法分析器
         } else if (isDelimiter(ch) != -1) { // 处理界符
             token[pos++] = ch; // 加入记号
             token[pos] = '\0'; // 添加字符串结束标志
             pos = 0; // 重置位置指针
 
             type = DEL; // 设置类别为界符
+            subtype = (enum TokenSubtype)(DEL_LPAREN + isDelimiter(ch)); // 界符子类别与界符集合顺序一致
+            tokid = -1;
             printToken(type, token); // 打印记号信息（可选）
             return; // 返回记号信息给语法分析器
         } else { // 处理错误字符
@@ -171,13 +563,381 @@ void lexicalAnalysis() {
     }
     strcpy(token, "EOF"); // 文件结束，设置记号为EOF
     type = ERR; // 设置类别为错误（用于表示文件结束）
+    subtype = SUB_EOF;
+    tokid = -1;
+}
+
+// 对源程序src的[begin, end)区间进行词法分析，把记号按结构数组形式追加到记号流ts中，标识符和数字常量驻留到it中；
+// 遇到非法字符或过长的记号时停止并返回该记号的位置，否则返回-1（不在这里报错，以便在工作线程中调用）
+int lexRange(const char *src, int begin, int end, struct TokenStream *ts, struct InternTable *it) {
+    int i = begin; // 当前字符位置
+    while (i < end) {
+        char c = src[i]; // 当前字符
+        int start = i; // 当前记号的起始位置
+        if (isspace(c)) { // 跳过空白字符
+            i++;
+            continue;
+        } else if (isLetter(c)) { // 处理标识符或关键字
+            while (i < end && (isLetter(src[i]) || isdigit(src[i]))) { // 读取后续字符直到非字母或数字
+                i++;
+            }
+            int index = keywordIndex(src + start, i - start); // 判断是否为关键字
+            if (index != -1) { // 是关键字
+                pushToken(ts, KEY, (enum TokenSubtype)(KW_INT + index), start, i - start, -1);
+            } else { // 不是关键字，驻留标识符
+                pushToken(ts, ID, SUB_NONE, start, i - start, internToken(it, src + start, i - start));
+            }
+        } else if (isdigit(c)) { // 处理数字常量
+            while (i < end && isdigit(src[i])) { // 读取后续字符直到非数字
+                i++;
+            }
+            pushToken(ts, NUM, SUB_NONE, start, i - start, internToken(it, src + start, i - start));
+        } else if (isOperator(c) != -1) { // 处理运算符
+            int index = i + 1 < end ? doubleOp(c, src[i + 1]) : -1; // 判断是否为双字符运算符
+            if (index != -1) { // 处理双字符运算符
+                i += 2;
+                pushToken(ts, OP, (enum TokenSubtype)index, start, 2, -1);
+            } else { // 处理单字符运算符
+                i++;
+                pushToken(ts, OP, (enum TokenSubtype)(OP_PLUS + isOperator(c)), start, 1, -1);
+            }
+        } else if (isDelimiter(c) != -1) { // 处理界符
+            i++;
+            pushToken(ts, DEL, (enum TokenSubtype)(DEL_LPAREN + isDelimiter(c)), start, 1, -1);
+        } else { // 处理错误字符
+            return start; // 由调用者报错，并行分词时按块的顺序报告第一个错误
+        }
+        if (i - start >= MAXLEN) { // 记号过长，无法存入符号表和四元式
+            return start;
+        }
+    }
+    return -1;
+}
+
+// 把一个记号追加到记号流的各个数组中，空间不足时自动扩容
+void pushToken(struct TokenStream *ts, enum TokenType kind, enum TokenSubtype sub, int offset, int length, int id) {
+    if (ts->num == ts->cap) { // 如果记号流已满，容量翻倍
+        ts->cap = ts->cap ? ts->cap * 2 : TOKENNUM;
+        ts->kind = (unsigned char *)realloc(ts->kind, ts->cap * sizeof(unsigned char));
+        ts->sub = (unsigned char *)realloc(ts->sub, ts->cap * sizeof(unsigned char));
+        ts->offset = (int *)realloc(ts->offset, ts->cap * sizeof(int));
+        ts->length = (int *)realloc(ts->length, ts->cap * sizeof(int));
+        ts->id = (int *)realloc(ts->id, ts->cap * sizeof(int));
+        if (ts->kind == NULL || ts->sub == NULL || ts->offset == NULL || ts->length == NULL || ts->id == NULL) { // 如果分配失败，报错并退出程序
+            error("Out of memory");
+        }
+    }
+    ts->kind[ts->num] = (unsigned char)kind;
+    ts->sub[ts->num] = (unsigned char)sub;
+    ts->offset[ts->num] = offset;
+    ts->length[ts->num] = length;
+    ts->id[ts->num] = id;
+    ts->num++;
+}
+
+// 计算长度为len的字符串的哈希值（FNV-1a）
+unsigned hashText(const char *text, int len) {
+    unsigned h = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)text[i]) * 16777619u;
+    }
+    return h;
+}
+
+// 驻留长度为len的字符串，返回其编号；相同的字符串总是得到相同的编号，编号按首次出现的顺序分配
+int internToken(struct InternTable *it, const char *text, int len) {
+    unsigned h = hashText(text, len); // 哈希值只计算一次
+    int found = findHashed(it, text, len, h); // 是否已驻留
+    if (found != -1) {
+        return found;
+    }
+    char *name = (char *)malloc(len + 1); // 复制一份字符串，之后只通过编号引用
+    if (name == NULL) { // 如果分配失败，报错并退出程序
+        error("Out of memory");
+    }
+    memcpy(name, text, len);
+    name[len] = '\0';
+    return addInterned(it, name, h);
+}
+
+// 把尚未驻留的字符串name（由驻留表接管）连同其哈希值h加入驻留表，返回新分配的编号
+int addInterned(struct InternTable *it, char *name, unsigned h) {
+    if (2 * (it->num + 1) > it->slotcap) { // 负载超过一半时哈希槽扩容，按保存的哈希值重新散列
+        int slotcap = it->slotcap ? it->slotcap * 2 : INTERNNUM;
+        int *slots = (int *)malloc(slotcap * sizeof(int));
+        if (slots == NULL) { // 如果分配失败，报错并退出程序
+            error("Out of memory");
+        }
+        for (int i = 0; i < slotcap; i++) {
+            slots[i] = -1;
+        }
+        for (int id = 0; id < it->num; id++) {
+            unsigned s = it->hash[id] & (slotcap - 1);
+            while (slots[s] != -1) {
+                s = (s + 1) & (slotcap - 1);
+            }
+            slots[s] = id;
+        }
+        free(it->slots);
+        it->slots = slots;
+        it->slotcap = slotcap;
+    }
+    unsigned s = h & (it->slotcap - 1);
+    while (it->slots[s] != -1) { // 线性探测找到空槽
+        s = (s + 1) & (it->slotcap - 1);
+    }
+    if (it->num == it->cap) { // 如果编号数组已满，容量翻倍
+        it->cap = it->cap ? it->cap * 2 : INTERNNUM;
+        it->names = (char **)realloc(it->names, it->cap * sizeof(char *));
+        it->sym = (int *)realloc(it->sym, it->cap * sizeof(int));
+        it->hash = (unsigned *)realloc(it->hash, it->cap * sizeof(unsigned));
+        if (it->names == NULL || it->sym == NULL || it->hash == NULL) { // 如果分配失败，报错并退出程序
+            error("Out of memory");
+        }
+    }
+    it->names[it->num] = name;
+    it->sym[it->num] = -1; // 尚未声明
+    it->hash[it->num] = h;
+    it->slots[s] = it->num;
+    return it->num++;
+}
+
+// 并行分词任务结构体，每个线程负责源程序中的一块
+struct LexTask {
+    const char *src; // 源程序文本
+    int begin; // 本块的起始位置
+    int end; // 本块的结束位置（不含）
+    struct TokenStream tokens; // 本块的记号流（驻留编号为块内编号）
+    struct InternTable interns; // 本块的驻留表，编号按块内首次出现的顺序分配
+    struct LexTask *all; // 所有块的任务数组（在前面的块中查找名字）
+    int index; // 本块的序号
+    int *owner; // 块内驻留编号对应的名字首次出现在哪一块
+    int *map; // 块内驻留编号到全局驻留编号的映射（拼接前对不是首次出现在本块的名字暂存其在首次出现的块中的编号）
+    int first; // 本块第一个记号在拼接后的记号流中的位置
+    int failed; // 出错记号的位置（-1表示没有出错）
+};
+
+// 分词工作线程函数，把一块源程序分词到该块自己的记号流和驻留表中
+void *lexWorker(void *arg) {
+    struct LexTask *task = (struct LexTask *)arg;
+    task->failed = lexRange(task->src, task->begin, task->end, &task->tokens, &task->interns);
+    return NULL;
+}
+
+// 查找工作线程函数，在前面各块的驻留表中（此时只读）依次查找本块的每个名字，记录它首次出现的块和在该块中的编号
+void *resolveWorker(void *arg) {
+    struct LexTask *task = (struct LexTask *)arg;
+    for (int id = 0; id < task->interns.num; id++) {
+        char *name = task->interns.names[id];
+        int len = strlen(name);
+        task->owner[id] = task->index; // 前面各块中都没有时，名字首次出现在本块
+        task->map[id] = id;
+        for (int k = 0; k < task->index; k++) {
+            int found = findHashed(&task->all[k].interns, name, len, task->interns.hash[id]); // 直接使用分词时保存的哈希值
+            if (found != -1) {
+                task->owner[id] = k;
+                task->map[id] = found;
+                break;
+            }
+        }
+    }
+    return NULL;
+}
+
+// 拼接工作线程函数，把一块的记号复制到拼接后的记号流中，并把驻留编号换成全局编号
+void *spliceWorker(void *arg) {
+    struct LexTask *task = (struct LexTask *)arg;
+    struct TokenStream *ts = &task->tokens;
+    int first = task->first;
+    for (int id = 0; id < task->interns.num; id++) { // 首次出现在前面的块中的名字，使用该块已分配的全局编号（只读取其他块中不会被改写的项）
+        if (task->owner[id] != task->index) {
+            task->map[id] = task->all[task->owner[id]].map[task->map[id]];
+        }
+    }
+    memcpy(tokens.kind + first, ts->kind, ts->num * sizeof(unsigned char));
+    memcpy(tokens.sub + first, ts->sub, ts->num * sizeof(unsigned char));
+    memcpy(tokens.offset + first, ts->offset, ts->num * sizeof(int)); // 记号位置本来就是在整个源程序中的位置
+    memcpy(tokens.length + first, ts->length, ts->num * sizeof(int));
+    for (int k = 0; k < ts->num; k++) {
+        tokens.id[first + k] = ts->id[k] == -1 ? -1 : task->map[ts->id[k]];
+    }
+    return NULL;
+}
+
+// 把整个源程序分词到全局记号流tokens和驻留表interns中：源程序较大且nthreads大于1时，在分号之后把源程序切成若干块，
+// 各线程分别分词到块内的记号流和驻留表，再并行地在前面各块的驻留表中查找每个名字，按块的顺序为首次出现的名字分配全局编号，
+// 最后并行拼接；得到的记号流和驻留编号与串行分词完全相同
+void lexParallel(const char *src, int size, int nthreads) {
+    int nchunks = size / LEXCHUNKMIN; // 块数
+    if (nchunks > nthreads) {
+        nchunks = nthreads;
+    }
+    if (nchunks > MAXTHREADS) {
+        nchunks = MAXTHREADS;
+    }
+    if (nchunks <= 1) { // 串行分词
+        int bad = lexRange(src, 0, size, &tokens, &interns);
+        if (bad != -1) {
+            lexError(src, bad);
+        }
+        return;
+    }
+    struct LexTask tasks[MAXTHREADS];
+    pthread_t threads[MAXTHREADS];
+    int begin = 0; // 下一块的起始位置
+    for (int k = 0; k < nchunks; k++) { // 按字节数大致均分，每块的结束位置向后移到分号之后（语言中没有注释和字符串，分号总是一个独立的记号）
+        int end = k == nchunks - 1 ? size : (int)((long long)size * (k + 1) / nchunks);
+        if (end < begin) {
+            end = begin;
+        }
+        while (end < size && (end == 0 || src[end - 1] != ';')) {
+            end++;
+        }
+        struct LexTask *task = &tasks[k];
+        memset(task, 0, sizeof(struct LexTask));
+        task->src = src;
+        task->begin = begin;
+        task->end = end;
+        task->all = tasks;
+        task->index = k;
+        begin = end;
+    }
+    for (int k = 0; k < nchunks; k++) { // 启动分词线程
+        if (pthread_create(&threads[k], NULL, lexWorker, &tasks[k]) != 0) {
+            error("Cannot create thread");
+        }
+    }
+    for (int k = 0; k < nchunks; k++) { // 等待所有分词线程结束
+        pthread_join(threads[k], NULL);
+    }
+    int total = 0; // 拼接后的记号个数
+    for (int k = 0; k < nchunks; k++) { // 按块的顺序报告第一个错误（与串行分词报告的相同），并确定各块在拼接后的位置
+        struct LexTask *task = &tasks[k];
+        if (task->failed != -1) {
+            lexError(src, task->failed);
+        }
+        task->first = total;
+        total += task->tokens.num;
+        task->owner = (int *)malloc((task->interns.num + 1) * sizeof(int));
+        task->map = (int *)malloc((task->interns.num + 1) * sizeof(int));
+        if (task->owner == NULL || task->map == NULL) { // 如果分配失败，报错并退出程序
+            error("Out of memory");
+        }
+    }
+    for (int k = 1; k < nchunks; k++) { // 启动查找线程（第一块中的名字都是首次出现）
+        if (pthread_create(&threads[k], NULL, resolveWorker, &tasks[k]) != 0) {
+            error("Cannot create thread");
+        }
+    }
+    resolveWorker(&tasks[0]);
+    for (int k = 1; k < nchunks; k++) { // 等待所有查找线程结束
+        pthread_join(threads[k], NULL);
+    }
+    for (int k = 0; k < nchunks; k++) { // 按块的顺序为首次出现的名字分配全局编号：块内编号按首次出现的顺序分配，全局编号也就与串行分词相同
+        struct LexTask *task = &tasks[k];
+        for (int id = 0; id < task->interns.num; id++) {
+            if (task->owner[id] == k) { // 这些名字互不相同，全局驻留表此时又为空，不必查找，字符串和哈希值直接移交给全局驻留表
+                task->map[id] = addInterned(&interns, task->interns.names[id], task->interns.hash[id]);
+                task->interns.names[id] = NULL;
+            }
+        }
+    }
+    tokens.cap = total > 0 ? total : 1;
+    tokens.num = total;
+    tokens.kind = (unsigned char *)malloc(tokens.cap * sizeof(unsigned char));
+    tokens.sub = (unsigned char *)malloc(tokens.cap * sizeof(unsigned char));
+    tokens.offset = (int *)malloc(tokens.cap * sizeof(int));
+    tokens.length = (int *)malloc(tokens.cap * sizeof(int));
+    tokens.id = (int *)malloc(tokens.cap * sizeof(int));
+    if (tokens.kind == NULL || tokens.sub == NULL || tokens.offset == NULL || tokens.length == NULL || tokens.id == NULL) { // 如果分配失败，报错并退出程序
+        error("Out of memory");
+    }
+    for (int k = 0; k < nchunks; k++) { // 启动拼接线程，各块复制到互不重叠的位置
+        if (pthread_create(&threads[k], NULL, spliceWorker, &tasks[k]) != 0) {
+            error("Cannot create thread");
+        }
+    }
+    for (int k = 0; k < nchunks; k++) { // 等待所有拼接线程结束（拼接时会读取其他块的映射，全部结束后才能释放）
+        pthread_join(threads[k], NULL);
+    }
+    for (int k = 0; k < nchunks; k++) { // 释放各块的记号流和驻留表
+        struct LexTask *task = &tasks[k];
+        free(task->tokens.kind);
+        free(task->tokens.sub);
+        free(task->tokens.offset);
+        free(task->tokens.length);
+        free(task->tokens.id);
+        freeInterned(&task->interns);
+        free(task->owner);
+        free(task->map);
+    }
+}
+
+// 报告分词时在位置pos处发现的错误：该位置是非法字符，或者从该位置开始的记号过长
+void lexError(const char *src, int pos) {
+    char c = src[pos]; // 出错记号的第一个字符
+    if (isLetter(c) || isdigit(c)) {
+        error("Token too long");
+    }
+    char bad[2] = {c, '\0'};
+    printToken(ERR, bad); // 打印记号信息（可选）
+    error("Invalid character"); // 报错并退出程序
+}
+
+// 查找长度为len的字符串的驻留编号，如果尚未驻留则返回-1（不修改驻留表）
+int findInterned(struct InternTable *it, const char *text, int len) {
+    return findHashed(it, text, len, hashText(text, len));
+}
+
+// 按已知的哈希值h查找长度为len的字符串的驻留编号，如果尚未驻留则返回-1（不修改驻留表，可在多个线程中并发调用）
+int findHashed(struct InternTable *it, const char *text, int len, unsigned h) {
+    if (it->slotcap == 0) { // 驻留表为空
+        return -1;
+    }
+    unsigned s = h & (it->slotcap - 1);
+    while (it->slots[s] != -1) { // 线性探测，哈希值相同时才比较字符串
+        int id = it->slots[s];
+        if (it->hash[id] == h && strncmp(it->names[id], text, len) == 0 && it->names[id][len] == '\0') {
+            return id;
+        }
+        s = (s + 1) & (it->slotcap - 1);
+    }
+    return -1;
+}
+
+// 释放驻留表及其中的字符串
+void freeInterned(struct InternTable *it) {
+    for (int id = 0; id < it->num; id++) {
+        free(it->names[id]);
+    }
+    free(it->names);
+    free(it->sym);
+    free(it->hash);
+    free(it->slots);
+}
+
+// 读入整个源程序文件，返回以'\0'结尾的缓冲区，size返回文件长度
+char *readSource(FILE *fp, int *size) {
+    fseek(fp, 0, SEEK_END);
+    long len = ftell(fp); // 文件长度
+    fseek(fp, 0, SEEK_SET);
+    char *src = (char *)malloc(len + 1);
+    if (src == NULL) { // 如果分配失败，报错并退出程序
+        error("Out of memory");
+    }
+    if (fread(src, 1, len, fp) != (size_t)len) { // 如果读取失败，报错并退出程序
+        error("Cannot read source file");
+    }
+    src[len] = '\0';
+    *size = (int)len;
+    return src;
 }
 
 // 语法分析函数，分析源程序的语法结构并生成四元式序列
 void syntaxAnalysis() {
     lexicalAnalysis(); // 获取第一个记号，开始语法分析过程
     program(); // 调用程序分析函数，对应产生式<程序> ::= <声明序列><语句序列>
-    if (strcmp(token, "EOF") != 0) { // 如果还有剩余的记号，说明语法错误
+    if (subtype != SUB_EOF) { // 如果还有剩余的记号，说明语法错误
         error("Syntax error"); 
     }
 }
@@ -186,31 +946,66 @@ void syntaxAnalysis() {
 void program() {
     declarationList(); // 调用声明序列分析函数，对应产生式<声明序列> ::= <声明><声明序列>|ε
     statementList(); // 调用语句序列分析函数，对应产生式<语句序列> ::= <语句><语句序列>|ε
+    int index = lookupId(internToken(&interns, "main", 4)); // 查找是否定义了main函数
+    if (index != -1 && symtab[index].kind == SYM_FUNC) { // 如果定义了main函数，顶层语句执行完后调用main函数并返回
+        if (symtab[index].nparams != 0) { // main函数不能有参数
+            error("Invalid main function");
+        }
+        char result[MAXLEN] = ""; // main函数的返回值作为程序的返回值（void函数没有返回值）
+        if (symtab[index].ret != KW_VOID) {
+            strcpy(result, newTemp());
+        }
+        emitQuad("CALL", "main", "0", result);
+        emitQuad("RET", result, "", "");
+    }
 }
 
 // 声明序列分析函数，对应产生式<声明序列> ::= <声明><声明序列>|ε
 void declarationList() {
-    if (type == KEY && (strcmp(token, "int") == 0 || strcmp(token, "char") == 0 || strcmp(token, "void") == 0)) { // 如果当前记号是类型关键字，说明有声明
+    while (isTypeKeyword()) { // 如果当前记号是类型关键字，说明有声明（用循环代替尾递归，栈深度不随源程序增长）
         declaration(); // 调用声明分析函数，对应产生式<声明> ::= <类型><标识符>;
-        declarationList(); // 递归调用声明序列分析函数，对应产生式<声明序列> ::= <声明><声明序列>
-    } else { // 如果当前记号不是类型关键字，说明没有声明，对应产生式<声明序列> ::= ε
-        return; // 直接返回
-    }
+        if (streaming && curFunc == -1 && quadnum >= STREAMWINDOW) { // 流式模式下窗口已满，立即输出（函数定义作为一个整体输出）
+            flushQuads(0);
+        }
+    } // 如果当前记号不是类型关键字，说明没有声明，对应产生式<声明序列> ::= ε
 }
 
-// 声明分析函数，对应产生式<声明> ::= <类型><标识符>;
+// 声明分析函数，对应产生式<声明> ::= <类型><标识符>;|<类型><标识符>[<常量>];|<函数定义>
 void declaration() {
-    type(); // 调用类型分析函数，对应产生式<类型> ::= int|char|void
-    char t[MAXLEN]; // 用于存储类型信息
-    strcpy(t, token); // 复制类型信息到t中
+    typeSpec(); // 调用类型分析函数，对应产生式<类型> ::= int|char|void
+    enum TokenSubtype t = subtype; // 记录类型关键字
     lexicalAnalysis(); // 获取下一个记号
-    if (type == ID) { // 如果当前记号是标识符，说明是合法的声明
-        char n[MAXLEN]; // 用于存储标识符名
-        strcpy(n, token); // 复制标识符名到n中
+    if (type == ID || subtype == KW_MAIN) { // 如果当前记号是标识符（或作为函数名的main），说明是合法的声明
+        int isMain = subtype == KW_MAIN; // main只能作为函数名
+        int n = isMain ? internToken(&interns, "main", 4) : tokid; // 记录标识符的驻留编号
         lexicalAnalysis(); // 获取下一个记号
-        if (type == DEL && strcmp(token, ";") == 0) { // 如果当前记号是分号，说明是合法的声明结束
-            insertSymbol(n, ID, 0); // 将标识符插入到符号表中，初始值为0
-            emitQuad("DEC", t, "", n); // 生成一个DEC四元式，表示为该标识符分配空间
+        if (subtype == DEL_LPAREN) { // 如果当前记号是左括号，说明是函数定义
+            functionDefinition(t, n);
+        } else if (subtype == DEL_SEMI && !isMain) { // 如果当前记号是分号，说明是合法的变量声明结束（main不能作为变量名）
+            insertSymbolId(n, ID, 0); // 将标识符插入到符号表中，初始值为0
+            emitQuad("DEC", subNames[t], "", symtab[symnum - 1].name); // 生成一个DEC四元式，表示为该标识符分配空间
+            lexicalAnalysis(); // 获取下一个记号，为后续的语法分析做准备
+        } else if (subtype == DEL_LBRACKET && !isMain) { // 如果当前记号是左方括号，说明是数组声明
+            lexicalAnalysis(); // 获取下一个记号
+            if (type != NUM) { // 数组大小必须是数字常量
+                error("Invalid array size");
+            }
+            char size[MAXLEN]; // 用于存储数组的元素个数
+            strcpy(size, interns.names[tokid]);
+            if (atoi(size) <= 0 || strlen(size) > 5 || atoi(size) > MAXARRAY) { // 元素个数必须在1~MAXARRAY之间
+                error("Invalid array size");
+            }
+            lexicalAnalysis(); // 获取下一个记号
+            if (subtype != DEL_RBRACKET) { // 如果当前记号不是右方括号，说明是语法错误
+                error("Missing ]");
+            }
+            lexicalAnalysis(); // 获取下一个记号
+            if (subtype != DEL_SEMI) { // 如果当前记号不是分号，说明是语法错误
+                error("Missing ;");
+            }
+            insertSymbolId(n, ID, 0); // 将数组名插入到符号表中
+            symtab[symnum - 1].size = atoi(size);
+            emitQuad("DEC", subNames[t], size, symtab[symnum - 1].name); // 生成一个DEC四元式，第二个操作数为元素个数，表示为整个数组分配空间
             lexicalAnalysis(); // 获取下一个记号，为后续的语法分析做准备
         } else { // 如果当前记号不是分号，说明是语法错误
             error("Missing ;");
@@ -220,9 +1015,72 @@ void declaration() {
     }
 }
 
+// 函数定义分析函数，对应产生式<函数定义> ::= <类型><标识符>(<参数表>){<声明序列><语句序列>}，<参数表> ::= ε|<类型><标识符>{,<类型><标识符>}
+void functionDefinition(enum TokenSubtype ret, int id) {
+    if (curFunc != -1) { // 函数不能嵌套定义
+        error("Nested function definition");
+    }
+    char skipLabel[MAXLEN]; // 用于存储跳过函数体的跳转标号（顺序执行的顶层代码不进入函数体）
+    strcpy(skipLabel, newLabel());
+    emitQuad("JMP", "", "", skipLabel); // 生成一个无条件跳转四元式，表示跳过函数体
+    insertSymbolId(id, ID, 0); // 将函数名插入到符号表中
+    int func = symnum - 1; // 函数在符号表中的位置
+    symtab[func].kind = SYM_FUNC;
+    symtab[func].ret = ret;
+    int begin = quadnum; // FUNC四元式的位置
+    emitQuad("FUNC", subNames[ret], "", symtab[func].name); // 生成一个FUNC四元式，表示函数入口（建立栈帧）
+    curFunc = func; // 进入函数，之后声明的符号都是局部符号
+
+    lexicalAnalysis(); // 获取下一个记号
+    if (subtype != DEL_RPAREN) { // 如果当前记号不是右括号，说明有参数
+        while (1) {
+            typeSpec(); // 调用类型分析函数，对应产生式<类型> ::= int|char|void
+            enum TokenSubtype t = subtype; // 记录参数类型
+            lexicalAnalysis(); // 获取下一个记号
+            if (type != ID) { // 如果当前记号不是标识符，说明是语法错误
+                error("Missing identifier");
+            }
+            if (symtab[func].nparams == MAXARGS) { // 参数只能通过$a0~$a3传递
+                error("Too many parameters");
+            }
+            insertSymbolId(tokid, ID, 0); // 将参数插入到符号表中
+            symtab[symnum - 1].kind = SYM_PARAM;
+            char index[MAXLEN]; // 用于存储参数序号
+            sprintf(index, "%d", symtab[func].nparams++);
+            emitQuad("PARAM", subNames[t], index, symtab[symnum - 1].name); // 生成一个PARAM四元式，表示把第index个参数寄存器保存到参数的栈帧位置
+            lexicalAnalysis(); // 获取下一个记号
+            if (subtype == DEL_COMMA) { // 如果当前记号是逗号，说明还有参数
+                lexicalAnalysis();
+            } else {
+                break;
+            }
+        }
+    }
+    sprintf(quadtab[begin].arg2, "%d", symtab[func].nparams); // 在FUNC四元式中记录参数个数
+    if (subtype != DEL_RPAREN) { // 如果当前记号不是右括号，说明是语法错误
+        error("Missing )");
+    }
+    lexicalAnalysis(); // 获取下一个记号
+    if (subtype != DEL_LBRACE) { // 如果当前记号不是左花括号，说明是语法错误
+        error("Missing {");
+    }
+    lexicalAnalysis(); // 获取下一个记号
+    declarationList(); // 调用声明序列分析函数，分析函数的局部变量声明
+    statementList(); // 调用语句序列分析函数，分析函数体语句
+    if (subtype != DEL_RBRACE) { // 如果当前记号不是右花括号，说明是语法错误
+        error("Missing }");
+    }
+    emitQuad("ENDF", "", "", symtab[func].name); // 生成一个ENDF四元式，表示函数结束（执行到函数末尾时返回调用者）
+    saveInlineBody(func, begin); // 如果函数足够小，保存函数体以便在调用处内联展开
+    leaveScope(); // 离开函数，恢复被局部符号遮盖的全局符号
+    curFunc = -1;
+    backpatch(skipLabel, quadnum); // 回填跳过函数体的跳转标号到函数之后的位置
+    lexicalAnalysis(); // 获取下一个记号，为后续的语法分析做准备
+}
+
 // 类型分析函数，对应产生式<类型> ::= int|char|void
-void type() {
-    if (type == KEY && (strcmp(token, "int") == 0 || strcmp(token, "char") == 0 || strcmp(token, "void") == 0)) { // 如果当前记号是类型关键字，说明是合法的类型
+void typeSpec() {
+    if (isTypeKeyword()) { // 如果当前记号是类型关键字，说明是合法的类型
         return; // 直接返回
     } else { // 如果当前记号不是类型关键字，说明是语法错误
         error("Invalid type");
@@ -231,45 +1089,69 @@ void type() {
 
 // 语句序列分析函数，对应产生式<语句序列> ::= <语句><语句序列>|ε
 void statementList() {
-    if ((type == ID) || (type == KEY && (strcmp(token, "if") == 0 || strcmp(token, "while") == 0 || strcmp(token, "return") == 0))) { // 如果当前记号是标识符或if、while、return关键字，说明有语句
-        statement(); // 调用语句分析函数，对应产生式<语句> ::= <赋值语句>|<条件语句>|<循环语句>|<返回语句>
-        statementList(); // 递归调用语句序列分析函数，对应产生式<语句序列> ::= <语句><语句序列>
-    } else { // 如果当前记号不是标识符或if、while、return关键字，说明没有语句，对应产生式<语句序列> ::= ε
-        return; // 直接返回
-    }
+    while (type == ID || subtype == KW_IF || subtype == KW_WHILE || subtype == KW_RETURN || subtype == DEL_LBRACE) { // 如果当前记号是标识符、if、while、return关键字或左花括号，说明有语句（用循环代替尾递归，栈深度不随源程序增长）
+        statement(); // 调用语句分析函数，对应产生式<语句> ::= <赋值语句>|<条件语句>|<循环语句>|<返回语句>|<复合语句>
+        if (streaming && curFunc == -1 && nesting == 0 && quadnum >= STREAMWINDOW) { // 顶层语句结束时其标号都已回填，流式模式下窗口已满则立即输出
+            flushQuads(0);
+        }
+    } // 如果当前记号不是标识符、if、while、return关键字或左花括号，说明没有语句，对应产生式<语句序列> ::= ε
 }
 
-// 语句分析函数，对应产生式<语句> ::= <赋值语句>|<条件语句>|<循环语句>|<返回语句>
+// 语句分析函数，对应产生式<语句> ::= <赋值语句>|<调用语句>|<条件语句>|<循环语句>|<返回语句>|<复合语句>
 void statement() {
-    if (type == ID) { // 如果当前记号是标识符，说明是赋值语句
+    nesting++; // 进入语句，内层的语句序列不是顶层语句
+    if (type == ID && lookupId(tokid) != -1 && symtab[lookupId(tokid)].kind == SYM_FUNC) { // 如果当前记号是函数名，说明是调用语句，对应产生式<调用语句> ::= <函数调用>;
+        call(""); // 调用函数调用分析函数，丢弃返回值
+        if (subtype == DEL_SEMI) { // 如果当前记号是分号，说明是合法的调用语句结束
+            lexicalAnalysis(); // 获取下一个记号，为后续的语法分析做准备
+        } else { // 如果当前记号不是分号，说明是语法错误
+            error("Missing ;");
+        }
+    } else if (type == ID) { // 如果当前记号是标识符，说明是赋值语句
         assignStatement(); // 调用赋值语句分析函数，对应产生式<赋值语句> ::= <标识符>=<表达式>;
-    } else if (type == KEY && strcmp(token, "if") == 0) { // 如果当前记号是if关键字，说明是条件语句
+    } else if (subtype == KW_IF) { // 如果当前记号是if关键字，说明是条件语句
         conditionStatement(); // 调用条件语句分析函数，对应产生式<条件语句> ::= if(<条件>)<语句>{else<语句>}
-    } else if (type == KEY && strcmp(token, "while") == 0) { // 如果当前记号是while关键字，说明是循环语句
+    } else if (subtype == KW_WHILE) { // 如果当前记号是while关键字，说明是循环语句
         loopStatement(); // 调用循环语句分析函数，对应产生式<循环语句> ::= while(<条件>)<语句>
-    } else if (type == KEY && strcmp(token, "return") == 0) { // 如果当前记号是return关键字，说明是返回语句
+    } else if (subtype == KW_RETURN) { // 如果当前记号是return关键字，说明是返回语句
         returnStatement(); // 调用返回语句分析函数，对应产生式<返回语句> ::= return;|return(<表达式>);
+    } else if (subtype == DEL_LBRACE) { // 如果当前记号是左花括号，说明是复合语句，对应产生式<复合语句> ::= {<语句序列>}
+        lexicalAnalysis(); // 获取下一个记号
+        statementList(); // 调用语句序列分析函数，分析复合语句中的语句
+        if (subtype != DEL_RBRACE) { // 如果当前记号不是右花括号，说明是语法错误
+            error("Missing }");
+        }
+        lexicalAnalysis(); // 获取下一个记号，为后续的语法分析做准备
     } else { // 如果当前记号不是以上任何一种情况，说明是语法错误
         error("Invalid statement");
     }
+    nesting--; // 离开语句
 }
 
-// 赋值语句分析函数，对应产生式<赋值语句> ::= <标识符>=<表达式>;
+// 赋值语句分析函数，对应产生式<赋值语句> ::= <标识符>=<表达式>;|<标识符>[<表达式>]=<表达式>;
 void assignStatement() {
-    char n[MAXLEN]; // 用于存储标识符名
-    strcpy(n, token); // 复制标识符名到n中
-    int index = lookupSymbol(n); // 查找符号表中是否有该标识符
-    if (index == -1) { // 如果没有找到，说明该标识符未声明，报错并退出程序
+    int n = tokid; // 记录标识符的驻留编号
+    int index = lookupId(n); // 查找符号表中是否有该标识符
+    if (index == -1 || symtab[index].kind == SYM_FUNC) { // 如果没有找到（或者是函数名），说明该标识符未声明为变量，报错并退出程序
         error("Undeclared identifier");
     }
     lexicalAnalysis(); // 获取下一个记号
-    if (type == OP && strcmp(token, "=") == 0) { // 如果当前记号是等号，说明是合法的赋值语句
+    char i[MAXLEN]; // 用于存储下标的结果位置（为空串时不是数组元素）
+    i[0] = '\0';
+    if (symtab[index].size > 0) { // 数组只能按元素赋值
+        subscript(index, i); // 调用下标分析函数，计算下标并生成越界检查
+    }
+    if (subtype == OP_ASSIGN) { // 如果当前记号是等号，说明是合法的赋值语句
         lexicalAnalysis(); // 获取下一个记号
         char e[MAXLEN]; // 用于存储表达式的结果位置（临时变量或标识符）
         expression(e); // 调用表达式分析函数，对应产生式<表达式> ::= <项>{+<项>|-<项>}，参数e用于存储表达式的结果位置（临时变量或标识符）
-        if (type == DEL && strcmp(token, ";") == 0) { // 如果当前记号是分号，说明是合法的赋值语句结束
-            emitQuad("=", e, "", n); // 生成一个赋值四元式，表示将表达式的结果赋给标识符
-            updateSymbol(index, atoi(e)); // 更新符号表中的值（如果表达式的结果是一个数字常量）
+        if (subtype == DEL_SEMI) { // 如果当前记号是分号，说明是合法的赋值语句结束
+            if (i[0] != '\0') { // 数组元素赋值，生成一个[]=四元式，表示将表达式的结果存入数组的第i个元素
+                emitQuad("[]=", e, i, symtab[index].name);
+            } else {
+                emitQuad("=", e, "", symtab[index].name); // 生成一个赋值四元式，表示将表达式的结果赋给标识符
+                updateSymbol(index, atoi(e)); // 更新符号表中的值（如果表达式的结果是一个数字常量）
+            }
             lexicalAnalysis(); // 获取下一个记号，为后续的语法分析做准备
         } else { // 如果当前记号不是分号，说明是语法错误
             error("Missing ;");
@@ -283,15 +1165,14 @@ void assignStatement() {
 void expression(char *place) {
     char t1[MAXLEN]; // 用于存储第一个项的结果位置（临时变量或标识符）
     term(t1); // 调用项分析函数，对应产生式<项> ::= <因子>{*<因子>|/<因子>|%<因子>}，参数t1用于存储第一个项的结果位置（临时变量或标识符）
-    while (type == OP && (strcmp(token, "+") == 0 || strcmp(token, "-") == 0)) { // 如果当前记号是加号或减号，说明有后续的项
-        char op[MAXLEN]; // 用于存储操作符
-        strcpy(op, token); // 复制操作符到op中
+    while (subtype == OP_PLUS || subtype == OP_MINUS) { // 如果当前记号是加号或减号，说明有后续的项
+        enum TokenSubtype op = subtype; // 记录操作符
         lexicalAnalysis(); // 获取下一个记号
         char t2[MAXLEN]; // 用于存储第二个项的结果位置（临时变量或标识符）
         term(t2); // 调用项分析函数，对应产生式<项> ::= <因子>{*<因子>|/<因子>|%<因子>}，参数t2用于存储第二个项的结果位置（临时变量或标识符）
         char t3[MAXLEN]; // 用于存储两个项的运算结果位置（临时变量）
         strcpy(t3, newTemp()); // 生成一个新的临时变量名并复制到t3中
-        emitQuad(op, t1, t2, t3); // 生成一个四元式，表示将两个项进行运算并将结果存入临时变量
+        emitQuad(subNames[op], t1, t2, t3); // 生成一个四元式，表示将两个项进行运算并将结果存入临时变量
         strcpy(t1, t3); // 将临时变量作为下一次运算的第一个操作数
     }
     strcpy(place, t1); // 将最终的表达式结果位置复制到place中
@@ -301,40 +1182,45 @@ void expression(char *place) {
 void term(char *place) {
     char f1[MAXLEN]; // 用于存储第一个因子的结果位置（临时变量或标识符）
     factor(f1); // 调用因子分析函数，对应产生式<因子> ::= <标识符>|<常量>|(<表达式>)，参数f1用于存储第一个因子的结果位置（临时变量或标识符）
-    while (type == OP && (strcmp(token, "*") == 0 || strcmp(token, "/") == 0 || strcmp(token, "%") == 0)) { // 如果当前记号是乘号、除号或取余号，说明有后续的因子
-        char op[MAXLEN]; // 用于存储操作符
-        strcpy(op, token); // 复制操作符到op中
+    while (subtype == OP_MUL || subtype == OP_DIV || subtype == OP_MOD) { // 如果当前记号是乘号、除号或取余号，说明有后续的因子
+        enum TokenSubtype op = subtype; // 记录操作符
         lexicalAnalysis(); // 获取下一个记号
         char f2[MAXLEN]; // 用于存储第二个因子的结果位置（临时变量或标识符）
         factor(f2); // 调用因子分析函数，对应产生式<因子> ::= <标识符>|<常量>|(<表达式>)，参数f2用于存储第二个因子的结果位置（临时变量或标识符）
         char f3[MAXLEN]; // 用于存储两个因子的运算结果位置（临时变量）
         strcpy(f3, newTemp()); // 生成一个新的临时变量名并复制到f3中
-        emitQuad(op, f1, f2, f3); // 生成一个四元式，表示将两个因子进行运算并将结果存入临时变量
+        emitQuad(subNames[op], f1, f2, f3); // 生成一个四元式，表示将两个因子进行运算并将结果存入临时变量
         strcpy(f1, f3); // 将临时变量作为下一次运算的第一个操作数
     }
     strcpy(place, f1); // 将最终的项结果位置复制到place中
 }
 
-// 因子分析函数，对应产生式<因子> ::= <标识符>|<常量>|(<表达式>)，参数place用于存储因子的结果位置（临时变量或标识符）
+// 因子分析函数，对应产生式<因子> ::= <标识符>|<标识符>[<表达式>]|<常量>|(<表达式>)|<函数调用>，参数place用于存储因子的结果位置（临时变量或标识符）
 void factor(char *place) {
-    if (type == ID) { // 如果当前记号是标识符，说明是合法的因子
-        char n[MAXLEN]; // 用于存储标识符名
-        strcpy(n, token); // 复制标识符名到n中
-        int index = lookupSymbol(n); // 查找符号表中是否有该标识符
+    if (type == ID && lookupId(tokid) != -1 && symtab[lookupId(tokid)].kind == SYM_FUNC) { // 如果当前记号是函数名，说明是函数调用
+        strcpy(place, newTemp()); // 生成一个新的临时变量名存放返回值
+        call(place); // 调用函数调用分析函数
+    } else if (type == ID) { // 如果当前记号是标识符，说明是合法的因子
+        int index = lookupId(tokid); // 查找符号表中是否有该标识符
         if (index == -1) { // 如果没有找到，说明该标识符未声明，报错并退出程序
             error("Undeclared identifier");
         }
-        strcpy(place, n); // 将标识符名复制到place中
-        lexicalAnalysis(); // 获取下一个记号，为后续的语法分析做准备
+        lexicalAnalysis(); // 获取下一个记号
+        if (symtab[index].size > 0) { // 如果是数组，说明是数组元素，对应产生式<因子> ::= <标识符>[<表达式>]
+            char i[MAXLEN]; // 用于存储下标的结果位置
+            subscript(index, i); // 调用下标分析函数，计算下标并生成越界检查
+            strcpy(place, newTemp()); // 生成一个新的临时变量名存放数组元素
+            emitQuad("=[]", symtab[index].name, i, place); // 生成一个=[]四元式，表示把数组的第i个元素取到临时变量中
+        } else {
+            strcpy(place, symtab[index].name); // 将标识符的符号名（局部变量带函数名前缀）写入place中
+        }
     } else if (type == NUM) { // 如果当前记号是数字常量，说明是合法的因子
-        char n[MAXLEN]; // 用于存储数字常量
-        strcpy(n, token); // 复制数字常量到n中
-        strcpy(place, n); // 将数字常量复制到place中
+        strcpy(place, interns.names[tokid]); // 将数字常量写入place中
         lexicalAnalysis(); // 获取下一个记号，为后续的语法分析做准备
-    } else if (type == DEL && strcmp(token, "(") == 0) { // 如果当前记号是左括号，说明是合法的因子，表示一个括号内的表达式
+    } else if (subtype == DEL_LPAREN) { // 如果当前记号是左括号，说明是合法的因子，表示一个括号内的表达式
         lexicalAnalysis(); // 获取下一个记号
         expression(place); // 调用表达式分析函数，对应产生式<表达式> ::= <项>{+<项>|-<项>}，参数place用于存储表达式的结果位置（临时变量或标识符）
-        if (type == DEL && strcmp(token, ")") == 0) { // 如果当前记号是右括号，说明是合法的因子结束
+        if (subtype == DEL_RPAREN) { // 如果当前记号是右括号，说明是合法的因子结束
             lexicalAnalysis(); // 获取下一个记号，为后续的语法分析做准备
         } else { // 如果当前记号不是右括号，说明是语法错误
             error("Missing )");
@@ -344,24 +1230,82 @@ void factor(char *place) {
     }
 }
 
+// 下标分析函数，对应产生式<下标> ::= [<表达式>]，array为数组在符号表中的位置，参数place用于存储下标的结果位置；生成一个越界检查四元式
+void subscript(int array, char *place) {
+    if (subtype != DEL_LBRACKET) { // 数组不能作为整体使用
+        error("Missing [");
+    }
+    lexicalAnalysis(); // 获取下一个记号
+    expression(place); // 调用表达式分析函数，计算下标
+    if (subtype != DEL_RBRACKET) { // 如果当前记号不是右方括号，说明是语法错误
+        error("Missing ]");
+    }
+    char size[MAXLEN]; // 用于存储数组的元素个数
+    sprintf(size, "%d", symtab[array].size);
+    emitQuad("BND", place, size, symtab[array].name); // 生成一个BND四元式，表示检查下标是否在[0, size)之内，越界时陷入
+    lexicalAnalysis(); // 获取下一个记号，为后续的语法分析做准备
+}
+
+// 函数调用分析函数，对应产生式<函数调用> ::= <标识符>(<实参表>)，<实参表> ::= ε|<表达式>{,<表达式>}，参数place用于存储返回值的位置（为空串时丢弃返回值）
+void call(char *place) {
+    int func = lookupId(tokid); // 被调用函数在符号表中的位置
+    lexicalAnalysis(); // 获取下一个记号
+    if (subtype != DEL_LPAREN) { // 如果当前记号不是左括号，说明是语法错误
+        error("Missing (");
+    }
+    lexicalAnalysis(); // 获取下一个记号
+    char args[MAXARGS][MAXLEN]; // 用于存储各个实参的结果位置
+    int nargs = 0; // 实参个数
+    if (subtype != DEL_RPAREN) { // 如果当前记号不是右括号，说明有实参
+        while (1) {
+            if (nargs == MAXARGS) { // 参数只能通过$a0~$a3传递
+                error("Too many arguments");
+            }
+            expression(args[nargs++]); // 先计算所有实参，避免嵌套调用覆盖已经传入的参数寄存器
+            if (subtype == DEL_COMMA) { // 如果当前记号是逗号，说明还有实参
+                lexicalAnalysis();
+            } else {
+                break;
+            }
+        }
+    }
+    if (subtype != DEL_RPAREN) { // 如果当前记号不是右括号，说明是语法错误
+        error("Missing )");
+    }
+    if (nargs != symtab[func].nparams) { // 实参个数必须与形参个数一致
+        error("Argument count mismatch");
+    }
+    if (place[0] != '\0' && symtab[func].ret == KW_VOID) { // void函数没有返回值，不能作为因子
+        error("Type mismatch");
+    }
+    char index[MAXLEN]; // 用于存储参数序号或实参个数
+    for (int k = 0; k < nargs; k++) {
+        sprintf(index, "%d", k);
+        emitQuad("ARG", args[k], index, ""); // 生成一个ARG四元式，表示把实参传入第k个参数寄存器
+    }
+    sprintf(index, "%d", nargs);
+    emitQuad("CALL", symtab[func].name, index, place); // 生成一个CALL四元式，表示调用函数并把返回值存入place
+    lexicalAnalysis(); // 获取下一个记号，为后续的语法分析做准备
+}
+
 // 条件语句分析函数，对应产生式<条件语句> ::= if(<条件>)<语句>{else<语句>}
 void conditionStatement() {
-    if (type == KEY && strcmp(token, "if") == 0) { // 如果当前记号是if关键字，说明是合法的条件语句开始
+    if (subtype == KW_IF) { // 如果当前记号是if关键字，说明是合法的条件语句开始
         lexicalAnalysis(); // 获取下一个记号
-        if (type == DEL && strcmp(token, "(") == 0) { // 如果当前记号是左括号，说明是合法的条件语句开始
+        if (subtype == DEL_LPAREN) { // 如果当前记号是左括号，说明是合法的条件语句开始
             lexicalAnalysis(); // 获取下一个记号
 
             char trueLabel[MAXLEN]; // 用于存储条件为真时的跳转标号
             char falseLabel[MAXLEN]; // 用于存储条件为假时的跳转标号
             condition(trueLabel, falseLabel); // 调用条件分析函数，对应产生式<条件> ::= <表达式><关系运算符><表达式>，参数trueLabel和falseLabel用于存储条件为真和为假时的跳转标号
 
-            if (type == DEL && strcmp(token, ")") == 0) { // 如果当前记号是右括号，说明是合法的条件语句开始
+            if (subtype == DEL_RPAREN) { // 如果当前记号是右括号，说明是合法的条件语句开始
                 lexicalAnalysis(); // 获取下一个记号
 
                 backpatch(trueLabel, quadnum); // 回填条件为真时的跳转标号到下一条四元式位置（即if语句块的开始位置）
                 statement(); // 调用语句分析函数，对应产生式<语句> ::= <赋值语句>|<条件语句>|<循环语句>|<返回语句>
 
-                if (type == KEY && strcmp(token, "else") == 0) { // 如果当前记号是else关键字，说明有else语句块
+                if (subtype == KW_ELSE) { // 如果当前记号是else关键字，说明有else语句块
                     char nextLabel[MAXLEN]; // 用于存储跳过else语句块的跳转标号
                     strcpy(nextLabel, newLabel()); // 生成一个新的标号名并复制到nextLabel中
                     emitQuad("JMP", "", "", nextLabel); // 生成一个无条件跳转四元式，表示跳过else语句块
@@ -387,9 +1331,8 @@ void conditionStatement() {
 void condition(char *trueLabel, char *falseLabel) {
     char e1[MAXLEN]; // 用于存储第一个表达式的结果位置（临时变量或标识符）
     expression(e1); // 调用表达式分析函数，对应产生式<表达式> ::= <项>{+<项>|-<项>}，参数e1用于存储第一个表达式的结果位置（临时变量或标识符）
-    if (type == OP && (strcmp(token, "<") == 0 || strcmp(token, "<=") == 0 || strcmp(token, ">") == 0 || strcmp(token, ">=") == 0 || strcmp(token, "==") == 0 || strcmp(token, "!=") == 0)) { // 如果当前记号是关系运算符，说明是合法的条件
-        char op[MAXLEN]; // 用于存储关系运算符
-        strcpy(op, token); // 复制关系运算符到op中
+    if (isRelOp()) { // 如果当前记号是关系运算符，说明是合法的条件
+        enum TokenSubtype op = subtype; // 记录关系运算符
         lexicalAnalysis(); // 获取下一个记号
         char e2[MAXLEN]; // 用于存储第二个表达式的结果位置（临时变量或标识符）
         expression(e2); // 调用表达式分析函数，对应产生式<表达式> ::= <项>{+<项>|-<项>}，参数e2用于存储第二个表达式的结果位置（临时变量或标识符）
@@ -397,7 +1340,7 @@ void condition(char *trueLabel, char *falseLabel) {
         strcpy(trueLabel, newLabel()); // 生成一个新的标号名并复制到trueLabel中
         strcpy(falseLabel, newLabel()); // 生成一个新的标号名并复制到falseLabel中
 
-        emitQuad(op, e1, e2, trueLabel); // 生成一个条件跳转四元式，表示如果两个表达式满足关系运算则跳转到trueLabel
+        emitQuad(subNames[op], e1, e2, trueLabel); // 生成一个条件跳转四元式，表示如果两个表达式满足关系运算则跳转到trueLabel
         emitQuad("JMP", "", "", falseLabel); // 生成一个无条件跳转四元式，表示否则跳转到falseLabel
     } else { // 如果当前记号不是关系运算符，说明是语法错误
         error("Invalid relation operator");
@@ -406,9 +1349,9 @@ void condition(char *trueLabel, char *falseLabel) {
 
 // 循环语句分析函数，对应产生式<循环语句> ::= while(<条件>)<语句>
 void loopStatement() {
-    if (type == KEY && strcmp(token, "while") == 0) { // 如果当前记号是while关键字，说明是合法的循环语句开始
+    if (subtype == KW_WHILE) { // 如果当前记号是while关键字，说明是合法的循环语句开始
         lexicalAnalysis(); // 获取下一个记号
-        if (type == DEL && strcmp(token, "(") == 0) { // 如果当前记号是左括号，说明是合法的循环语句开始
+        if (subtype == DEL_LPAREN) { // 如果当前记号是左括号，说明是合法的循环语句开始
             lexicalAnalysis(); // 获取下一个记号
 
             char beginLabel[MAXLEN]; // 用于存储循环开始时的跳转标号
@@ -419,7 +1362,7 @@ void loopStatement() {
             char falseLabel[MAXLEN]; // 用于存储条件为假时的跳转标号
             condition(trueLabel, falseLabel); // 调用条件分析函数，对应产生式<条件> ::= <表达式><关系运算符><表达式>，参数trueLabel和falseLabel用于存储条件为真和为假时的跳转标号
 
-            if (type == DEL && strcmp(token, ")") == 0) { // 如果当前记号是右括号，说明是合法的循环语句开始
+            if (subtype == DEL_RPAREN) { // 如果当前记号是右括号，说明是合法的循环语句开始
                 lexicalAnalysis(); // 获取下一个记号
 
                 backpatch(trueLabel, quadnum); // 回填条件为真时的跳转标号到下一条四元式位置（即while语句块的开始位置）
@@ -439,19 +1382,19 @@ void loopStatement() {
 
 // 返回语句分析函数，对应产生式<返回语句> ::= return;|return(<表达式>);
 void returnStatement() {
-    if (type == KEY && strcmp(token, "return") == 0) { // 如果当前记号是return关键字，说明是合法的返回语句开始
+    if (subtype == KW_RETURN) { // 如果当前记号是return关键字，说明是合法的返回语句开始
         lexicalAnalysis(); // 获取下一个记号
-        if (type == DEL && strcmp(token, ";") == 0) { // 如果当前记号是分号，说明是合法的返回语句结束，对应产生式return;
-            emitQuad("RET", "", "", ""); // 生成一个RET四元式，表示返回主函数
+        if (subtype == DEL_SEMI) { // 如果当前记号是分号，说明是合法的返回语句结束，对应产生式return;
+            emitQuad("RET", "", "", curFunc == -1 ? "" : symtab[curFunc].name); // 生成一个RET四元式，表示返回主函数（在函数中时记录函数名）
             lexicalAnalysis(); // 获取下一个记号，为后续的语法分析做准备
-        } else if (type == DEL && strcmp(token, "(") == 0) { // 如果当前记号是左括号，说明是合法的返回语句开始，对应产生式return(<表达式>);
+        } else if (subtype == DEL_LPAREN) { // 如果当前记号是左括号，说明是合法的返回语句开始，对应产生式return(<表达式>);
             lexicalAnalysis(); // 获取下一个记号
             char e[MAXLEN]; // 用于存储表达式的结果位置（临时变量或标识符）
             expression(e); // 调用表达式分析函数，对应产生式<表达式> ::= <项>{+<项>|-<项>}，参数e用于存储表达式的结果位置（临时变量或标识符）
-            if (type == DEL && strcmp(token, ")") == 0) { // 如果当前记号是右括号，说明是合法的返回语句开始
+            if (subtype == DEL_RPAREN) { // 如果当前记号是右括号，说明是合法的返回语句开始
                 lexicalAnalysis(); // 获取下一个记号
-                if (type == DEL && strcmp(token, ";") == 0) { // 如果当前记号是分号，说明是合法的返回语句结束
-                    emitQuad("RET", e, "", ""); // 生成一个RET四元式，表示返回表达式的结果
+                if (subtype == DEL_SEMI) { // 如果当前记号是分号，说明是合法的返回语句结束
+                    emitQuad("RET", e, "", curFunc == -1 ? "" : symtab[curFunc].name); // 生成一个RET四元式，表示返回表达式的结果（在函数中时记录函数名）
                     lexicalAnalysis(); // 获取下一个记号，为后续的语法分析做准备
                 } else { // 如果当前记号不是分号，说明是语法错误
                     error("Missing ;");
@@ -483,6 +1426,49 @@ int isKeyword(char *token) {
     return -1;
 }
 
+// 判断长度为len的字符串是否为关键字，是则返回其序号，否则返回-1
+int keywordIndex(const char *text, int len) {
+    for (int i = 0; i < KEYNUM; i++) {
+        if (strncmp(text, keywords[i], len) == 0 && keywords[i][len] == '\0') {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// 判断ch和next是否组成双字符运算符（<=、>=、==、!=、&&、||），是则返回其子类别，否则返回-1
+int doubleOp(char ch, char next) {
+    if (next == '=') {
+        switch (ch) {
+            case '<':
+                return OP_LE;
+            case '>':
+                return OP_GE;
+            case '=':
+                return OP_EQ;
+            case '!':
+                return OP_NE;
+            default:
+                break;
+        }
+    } else if (ch == next && ch == '&') {
+        return OP_ANDAND;
+    } else if (ch == next && ch == '|') {
+        return OP_OROR;
+    }
+    return -1;
+}
+
+// 判断当前记号是否为类型关键字（int、char、void）
+int isTypeKeyword() {
+    return subtype == KW_INT || subtype == KW_CHAR || subtype == KW_VOID;
+}
+
+// 判断当前记号是否为关系运算符（<、<=、>、>=、==、!=）
+int isRelOp() {
+    return subtype == OP_LT || subtype == OP_LE || subtype == OP_GT || subtype == OP_GE || subtype == OP_EQ || subtype == OP_NE;
+}
+
 // 判断是否为字母或下划线
 int isLetter(char ch) {
     return isalpha(ch) || ch == '_';
@@ -501,7 +1487,7 @@ int isOperator(char ch) {
 
 // 判断是否为界符，是则返回其序号，否则返回-1
 int isDelimiter(char ch) {
-    char dels[] = "(),;{}"; // 界符集合
+    char dels[] = "(),;{}[]"; // 界符集合
     for (int i = 0; i < strlen(dels); i++) {
         if (ch == dels[i]) {
             return i;
@@ -538,28 +1524,90 @@ void printToken(enum TokenType type, char *token) {
 
 // 查找符号表，返回符号在表中的位置，如果不存在则返回-1
 int lookupSymbol(char *name) {
-    for (int i = 0; i < symnum; i++) {
-        if (strcmp(name, symtab[i].name) == 0) {
-            return i;
-        }
-    }
-    return -1;
+    int id = findInterned(&symnames, name, strlen(name)); // 按符号名散列查找，不随符号表增长而变慢
+    return id == -1 ? -1 : symnames.sym[id];
 }
 
-// 插入符号表，如果已存在则报错
-void insertSymbol(char *name, enum TokenType type, int value) {
-    int index = lookupSymbol(name); // 查找符号表中是否有该标识符
-    if (index != -1) { // 如果已存在，报错并退出程序
-        error("Duplicate declaration");
-    } else { // 如果不存在，插入到符号表中
-        strcpy(symtab[symnum].name, name); // 复制标识符名到符号表中
-        symtab[symnum].type = type; // 设置标识符类别
-        symtab[symnum].value = value; // 设置标识符值
-        symnum++; // 增加符号表大小
-    }
+// 按驻留编号查找符号表，返回符号在表中的位置，如果不存在则返回-1（不需要比较字符串）
+int lookupId(int id) {
+    return interns.sym[id];
 }
 
-// 更新符号表中的值
+// 按驻留编号插入符号表，如果已存在则报错；在函数中插入的是局部符号（符号名为“函数名.变量名”），可以遮盖同名的全局符号
+void insertSymbolId(int id, enum TokenType type, int value) {
+    int old = lookupId(id); // 当前可见的同名符号
+    if (old != -1 && (curFunc == -1 || symtab[old].scope == curFunc || old == curFunc)) { // 如果在同一作用域中已存在，报错并退出程序
+        error("Duplicate declaration");
+    }
+    if (curFunc == -1) { // 全局符号
+        appendSymbol(interns.names[id], type, value); // 插入到符号表中（上面已按驻留编号检查过重复）
+    } else { // 局部符号，记录被遮盖的符号以便离开函数时恢复
+        char name[MAXLEN]; // 局部符号名
+        if (strlen(symtab[curFunc].name) + strlen(interns.names[id]) + 2 > MAXLEN) {
+            error("Identifier too long");
+        }
+        strcpy(name, symtab[curFunc].name);
+        strcat(name, ".");
+        strcat(name, interns.names[id]);
+        appendSymbol(name, type, value); // 插入到符号表中
+        if (scopenum == scopecap) { // 如果作用域表已满，容量翻倍
+            scopecap = scopecap ? scopecap * 2 : SYMNUM;
+            scopetab = (struct ScopeEntry *)realloc(scopetab, scopecap * sizeof(struct ScopeEntry));
+            if (scopetab == NULL) { // 如果分配失败，报错并退出程序
+                error("Out of memory");
+            }
+        }
+        scopetab[scopenum].id = id;
+        scopetab[scopenum].old = old;
+        scopenum++;
+    }
+    interns.sym[id] = symnum - 1; // 记录驻留编号对应的符号表位置
+}
+
+// 离开函数，按相反顺序恢复被局部符号遮盖的符号
+void leaveScope() {
+    while (scopenum > 0) {
+        scopenum--;
+        interns.sym[scopetab[scopenum].id] = scopetab[scopenum].old;
+    }
+}
+
+// 插入符号表，如果已存在则报错
+void insertSymbol(char *name, enum TokenType type, int value) {
+    int index = lookupSymbol(name); // 查找符号表中是否有该标识符
+    if (index != -1) { // 如果已存在，报错并退出程序
+        error("Duplicate declaration");
+    } else { // 如果不存在，插入到符号表中
+        appendSymbol(name, type, value);
+    }
+}
+
+// 把符号追加到符号表末尾并登记符号名（调用者已检查过不重复）
+void appendSymbol(char *name, enum TokenType type, int value) {
+    if (symnum == symcap) { // 如果符号表已满，容量翻倍
+        symcap = symcap ? symcap * 2 : SYMNUM;
+        symtab = (struct Symbol *)realloc(symtab, symcap * sizeof(struct Symbol));
+        if (symtab == NULL) { // 如果分配失败，报错并退出程序
+            error("Out of memory");
+        }
+    }
+    strcpy(symtab[symnum].name, name); // 复制标识符名到符号表中
+    int id = internToken(&symnames, name, strlen(name)); // 登记符号名到符号表位置的映射（驻留时sym数组可能扩容，先取编号）
+    symnames.sym[id] = symnum;
+    symtab[symnum].type = type; // 设置标识符类别
+    symtab[symnum].value = value; // 设置标识符值
+    symtab[symnum].address = 0; // 地址在语义分析时分配
+    symtab[symnum].kind = SYM_VAR; // 默认为变量
+    symtab[symnum].scope = curFunc; // 所属函数
+    symtab[symnum].nparams = 0;
+    symtab[symnum].frame = 0;
+    symtab[symnum].body = -1; // 默认不可内联
+    symtab[symnum].size = 0; // 默认为标量
+    symtab[symnum].ret = KW_INT;
+    symnum++; // 增加符号表大小
+}
+
+// 更新符号表中的值
 void updateSymbol(int index, int value) {
     if (index >= 0 && index < symnum) { // 如果索引合法，更新符号表中的值
         symtab[index].value = value;
@@ -568,24 +1616,31 @@ void updateSymbol(int index, int value) {
     }
 }
 
-// 生成一个新的临时变量名
+// 生成一个新的临时变量名（返回静态缓冲区，调用者需在下次调用前复制，避免每次分配内存）
 char *newTemp() {
     static int count = 0; // 用于记录临时变量的个数
-    char *temp = (char *)malloc(MAXLEN * sizeof(char)); // 分配内存空间
-    sprintf(temp, "t%d", count++); // 生成临时变量名，如t0, t1, t2, ...
+    static char temp[MAXLEN]; // 临时变量名缓冲区
+    sprintf(temp, "t.%d", count++); // 生成临时变量名，如t.0, t.1, t.2, ...（含有.，不会与标识符冲突）
     return temp;
 }
 
-// 生成一个新的标号名
+// 生成一个新的标号名（返回静态缓冲区，调用者需在下次调用前复制，避免每次分配内存）
 char *newLabel() {
     static int count = 0; // 用于记录标号的个数
-    char *label = (char *)malloc(MAXLEN * sizeof(char)); // 分配内存空间
-    sprintf(label, "L%d", count++); // 生成标号名，如L0, L1, L2, ...
+    static char label[MAXLEN]; // 标号名缓冲区
+    sprintf(label, ".L%d", count++); // 生成标号名，如.L0, .L1, .L2, ...（以.开头，不会与函数名冲突）
     return label;
 }
 
 // 生成一个四元式并加入到四元式序列中
 void emitQuad(char *op, char *arg1, char *arg2, char *result) {
+    if (quadnum == quadcap) { // 如果四元式序列已满，容量翻倍
+        quadcap = quadcap ? quadcap * 2 : QUADNUM;
+        quadtab = (struct Quadruple *)realloc(quadtab, quadcap * sizeof(struct Quadruple));
+        if (quadtab == NULL) { // 如果分配失败，报错并退出程序
+            error("Out of memory");
+        }
+    }
     strcpy(quadtab[quadnum].op, op); // 复制操作符到四元式中
     strcpy(quadtab[quadnum].arg1, arg1); // 复制第一个操作数到四元式中
     strcpy(quadtab[quadnum].arg2, arg2); // 复制第二个操作数到四元式中
@@ -595,8 +1650,17 @@ void emitQuad(char *op, char *arg1, char *arg2, char *result) {
 
 // 回填跳转标号到指定的四元式位置
 void backpatch(char *label, int quadpos) {
-    if (quadpos >= 0 && quadpos < quadnum) { // 如果位置合法，回填跳转标号到四元式的结果字段中
-        strcpy(quadtab[quadpos].result, label);
+    if (quadpos >= 0 && quadpos <= quadnum) { // 如果位置合法（可以指向下一条将要生成的四元式），把标号登记到标号表中
+        if (labelnum == labelcap) { // 如果标号表已满，容量翻倍
+            labelcap = labelcap ? labelcap * 2 : LABELNUM;
+            labeltab = (struct Label *)realloc(labeltab, labelcap * sizeof(struct Label));
+            if (labeltab == NULL) { // 如果分配失败，报错并退出程序
+                error("Out of memory");
+            }
+        }
+        strcpy(labeltab[labelnum].name, label); // 复制标号名到标号表中
+        labeltab[labelnum].quadpos = quadpos; // 记录标号指向的四元式位置
+        labelnum++; // 增加标号表大小
     } else { // 如果位置不合法，报错并退出程序
         error("Invalid quadruple position");
     }
@@ -607,13 +1671,21 @@ void printQuad(struct Quadruple quad) {
     printf("(%s, %s, %s, %s)\n", quad.op, quad.arg1, quad.arg2, quad.result);
 }
 
-// 打印四元式序列信息（可选）
+// 打印四元式序列信息（可选），标号打印在其所指的四元式之前
 void printQuadList() {
     printf("Quadruple list:\n");
+    int label = 0; // 下一个待打印的标号
     for (int i = 0; i < quadnum; i++) {
+        while (label < labelnum && labeltab[label].quadpos == i) {
+            printf("%s:\n", labeltab[label].name);
+            label++;
+        }
         printf("%d: ", i);
         printQuad(quadtab[i]);
     }
+    for (; label < labelnum; label++) { // 指向序列末尾的标号
+        printf("%s:\n", labeltab[label].name);
+    }
 }
 
 // 打印符号表项信息（可选）
@@ -629,250 +1701,1955 @@ void printSymbolList() {
     }
 }
 
+// 如果函数是足够小的叶函数，把函数体（不含FUNC和ENDF）及其中的标号保存到内联表中；begin为FUNC四元式的位置
+void saveInlineBody(int func, int begin) {
+    int end = quadnum - 1; // ENDF四元式的位置
+    int cost = 0; // 内联代价（函数体中除参数和变量声明以外的四元式数目）
+    for (int i = begin + 1; i < end; i++) {
+        if (strcmp(quadtab[i].op, "CALL") == 0) { // 只内联叶函数，避免递归展开
+            return;
+        }
+        if (strcmp(quadtab[i].op, "PARAM") != 0 && strcmp(quadtab[i].op, "DEC") != 0) {
+            cost++;
+        }
+    }
+    if (cost > INLINECOST) { // 函数体太大，调用开销相对较小，不内联
+        return;
+    }
+    inltab = (struct InlineBody *)realloc(inltab, (inlnum + 1) * sizeof(struct InlineBody));
+    if (inltab == NULL) { // 如果分配失败，报错并退出程序
+        error("Out of memory");
+    }
+    struct InlineBody *body = &inltab[inlnum];
+    body->quadnum = end - begin - 1;
+    body->quads = (struct Quadruple *)malloc((body->quadnum + 1) * sizeof(struct Quadruple));
+    memcpy(body->quads, quadtab + begin + 1, body->quadnum * sizeof(struct Quadruple));
+    int first = findLabel(begin + 1); // 函数体中的第一个标号
+    int last = findLabel(end + 1); // 函数体之后的第一个标号
+    body->labelnum = last - first;
+    body->labels = (struct Label *)malloc((body->labelnum + 1) * sizeof(struct Label));
+    if (body->quads == NULL || body->labels == NULL) { // 如果分配失败，报错并退出程序
+        error("Out of memory");
+    }
+    for (int k = 0; k < body->labelnum; k++) { // 标号位置改为相对于函数体开头
+        body->labels[k] = labeltab[first + k];
+        body->labels[k].quadpos -= begin + 1;
+    }
+    body->valued = body->quadnum > 0 && strcmp(body->quads[body->quadnum - 1].op, "RET") == 0 && body->quads[body->quadnum - 1].arg1[0] != '\0';
+    for (int k = 0; k < body->quadnum; k++) { // 不带返回值的RET
+        if (strcmp(body->quads[k].op, "RET") == 0 && body->quads[k].arg1[0] == '\0') {
+            body->valued = 0;
+        }
+    }
+    if (body->labelnum > 0 && body->labels[body->labelnum - 1].quadpos == body->quadnum) { // 从函数体中间跳到末尾，不经过最后的RET
+        body->valued = 0;
+    }
+    symtab[func].body = inlnum++;
+}
+
+// 判断操作数是否为临时变量（t.后跟数字，标识符中不会出现.）
+int isTemp(char *name) {
+    if (name[0] != 't' || name[1] != '.' || name[2] == '\0') {
+        return 0;
+    }
+    for (int i = 2; name[i] != '\0'; i++) {
+        if (!isdigit(name[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 返回临时变量的编号
+int tempNumber(char *name) {
+    return atoi(name + 2);
+}
+
+// 在内联重命名表中查找name，找到则返回新名字，否则在create不为NULL时用create生成新名字并登记，返回NULL表示不需要重命名
+char *renameLookup(struct Rename *map, int *mapnum, char *name, char *(*create)()) {
+    for (int k = 0; k < *mapnum; k++) {
+        if (strcmp(map[k].from, name) == 0) {
+            return map[k].to;
+        }
+    }
+    if (create == NULL) {
+        return NULL;
+    }
+    strcpy(map[*mapnum].from, name);
+    strcpy(map[*mapnum].to, create());
+    return map[(*mapnum)++].to;
+}
+
+// 对内联函数体中的操作数重命名：被调函数的参数和局部变量、临时变量在每个展开副本中都使用新名字
+char *renameOperand(struct Rename *map, int *mapnum, char *name) {
+    char *renamed = renameLookup(map, mapnum, name, NULL);
+    if (renamed != NULL) { // 已登记的参数、局部变量或临时变量
+        return renamed;
+    }
+    if (isTemp(name)) { // 首次出现的临时变量，生成新的临时变量
+        return renameLookup(map, mapnum, name, newTemp);
+    }
+    return name; // 全局变量和常量保持不变
+}
+
+// 在当前位置展开对函数callee的调用：args为nargs个ARG四元式，result为返回值的位置，caller为调用者所在函数（-1表示顶层）
+void expandInline(int callee, int caller, struct Quadruple *args, int nargs, char *result) {
+    static int instance = 0; // 展开副本编号，用于生成不重复的符号名
+    struct InlineBody *body = &inltab[symtab[callee].body];
+    struct Rename *map = (struct Rename *)malloc((3 * body->quadnum + body->labelnum + 1) * sizeof(struct Rename)); // 重命名表
+    if (map == NULL) { // 如果分配失败，报错并退出程序
+        error("Out of memory");
+    }
+    int mapnum = 0; // 重命名表大小
+    instance++;
+    for (int b = 0; b < body->quadnum; b++) { // 为被调函数的参数和局部变量在调用者中声明新的副本
+        struct Quadruple q = body->quads[b];
+        if (strcmp(q.op, "PARAM") == 0 || strcmp(q.op, "DEC") == 0) {
+            char name[MAXLEN]; // 副本的符号名
+            if (strlen(q.result) + 12 > MAXLEN) {
+                error("Identifier too long");
+            }
+            char suffix[16]; // 副本编号后缀
+            sprintf(suffix, "#%d", instance);
+            strcpy(name, q.result);
+            strcat(name, suffix);
+            insertSymbol(name, ID, 0);
+            symtab[symnum - 1].scope = caller; // 副本属于调用者的作用域
+            char *size = strcmp(q.op, "DEC") == 0 ? q.arg2 : ""; // 数组的元素个数（PARAM四元式的第二个操作数是参数序号）
+            symtab[symnum - 1].size = atoi(size);
+            strcpy(map[mapnum].from, q.result);
+            strcpy(map[mapnum].to, name);
+            mapnum++;
+            emitQuad("DEC", q.arg1, size, name); // 生成一个DEC四元式，表示为副本分配空间
+        }
+    }
+    for (int b = 0; b < body->quadnum; b++) { // 把实参赋给参数副本
+        struct Quadruple q = body->quads[b];
+        if (strcmp(q.op, "PARAM") == 0) {
+            int k = atoi(q.arg2);
+            if (k < nargs) {
+                emitQuad("=", args[k].arg1, "", renameOperand(map, &mapnum, q.result));
+            }
+        }
+    }
+    for (int l = 0; l < body->labelnum; l++) { // 函数体中的标号按副本编号重命名（不用newLabel，流式和整体编译时展开得到相同的标号名）
+        if (strlen(body->labels[l].name) + 12 > MAXLEN) {
+            error("Identifier too long");
+        }
+        char suffix[16]; // 副本编号后缀
+        sprintf(suffix, ".%d", instance);
+        strcpy(map[mapnum].from, body->labels[l].name);
+        strcpy(map[mapnum].to, body->labels[l].name);
+        strcat(map[mapnum].to, suffix);
+        mapnum++;
+    }
+    char endLabel[MAXLEN]; // 展开副本结束处的标号，函数体中间的返回跳转到这里
+    sprintf(endLabel, ".Lret.%d", instance);
+    int usedEnd = 0; // 是否用到了结束标号
+    int label = 0; // 下一个待回填的函数体标号
+    for (int b = 0; b < body->quadnum; b++) { // 复制函数体，重命名操作数和标号
+        while (label < body->labelnum && body->labels[label].quadpos == b) {
+            backpatch(renameLookup(map, &mapnum, body->labels[label].name, NULL), quadnum);
+            label++;
+        }
+        struct Quadruple q = body->quads[b];
+        if (strcmp(q.op, "PARAM") == 0 || strcmp(q.op, "DEC") == 0) { // 已在前面声明
+            continue;
+        } else if (strcmp(q.op, "RET") == 0) { // 返回：把返回值赋给调用结果，并跳到副本结束处
+            if (result[0] != '\0' && q.arg1[0] != '\0') {
+                emitQuad("=", renameOperand(map, &mapnum, q.arg1), "", result);
+            }
+            if (b != body->quadnum - 1) {
+                emitQuad("JMP", "", "", endLabel);
+                usedEnd = 1;
+            }
+        } else if (isBranch(q)) { // 跳转：结果字段是标号
+            char arg1[MAXLEN], arg2[MAXLEN];
+            strcpy(arg1, renameOperand(map, &mapnum, q.arg1));
+            strcpy(arg2, renameOperand(map, &mapnum, q.arg2));
+            emitQuad(q.op, arg1, arg2, renameLookup(map, &mapnum, q.result, NULL));
+        } else {
+            char arg1[MAXLEN], arg2[MAXLEN];
+            strcpy(arg1, renameOperand(map, &mapnum, q.arg1));
+            strcpy(arg2, renameOperand(map, &mapnum, q.arg2));
+            emitQuad(q.op, arg1, arg2, renameOperand(map, &mapnum, q.result));
+        }
+    }
+    for (; label < body->labelnum; label++) { // 指向函数体末尾的标号
+        backpatch(renameLookup(map, &mapnum, body->labels[label].name, NULL), quadnum);
+    }
+    if (usedEnd) {
+        backpatch(endLabel, quadnum);
+    }
+    free(map);
+}
+
+// 判断对函数callee的调用能否内联展开，result为返回值存入的位置；需要返回值时函数体必须在每条路径上都返回值，否则展开后结果未定义
+int canInline(int callee, char *result) {
+    return callee != -1 && symtab[callee].body != -1 && (result[0] == '\0' || inltab[symtab[callee].body].valued);
+}
+
+// 内联展开四元式序列中对小的叶函数的调用（ARG…CALL序列），重建四元式序列和标号表，返回展开的调用个数
+int inlineCalls() {
+    int found = 0; // 是否有可以内联的调用
+    for (int i = 0; i < quadnum && !found; i++) {
+        if (strcmp(quadtab[i].op, "CALL") == 0) {
+            found = canInline(lookupSymbol(quadtab[i].arg1), quadtab[i].result);
+        }
+    }
+    if (!found) {
+        return 0;
+    }
+    struct Quadruple *oldq = quadtab; // 原四元式序列
+    int oldn = quadnum;
+    struct Label *oldl = labeltab; // 原标号表
+    int oldln = labelnum;
+    quadtab = NULL; // 在新的数组中重新生成四元式序列和标号表
+    quadnum = quadcap = 0;
+    labeltab = NULL;
+    labelnum = labelcap = 0;
+    int count = 0; // 展开的调用个数
+    int caller = -1; // 当前所在函数
+    int label = 0; // 下一个待回填的原标号
+    for (int i = 0; i < oldn; i++) {
+        while (label < oldln && oldl[label].quadpos == i) { // 原标号回填到新位置
+            backpatch(oldl[label].name, quadnum);
+            label++;
+        }
+        struct Quadruple q = oldq[i];
+        if (strcmp(q.op, "FUNC") == 0) {
+            caller = lookupSymbol(q.result);
+        }
+        if (strcmp(q.op, "ARG") == 0 || strcmp(q.op, "CALL") == 0) {
+            int j = i; // CALL四元式的位置
+            while (strcmp(oldq[j].op, "ARG") == 0) {
+                j++;
+            }
+            int callee = lookupSymbol(oldq[j].arg1);
+            int split = label < oldln && oldl[label].quadpos <= j; // 有标号指向调用序列中间时不展开
+            if (canInline(callee, oldq[j].result) && !split) {
+                expandInline(callee, caller, oldq + i, j - i, oldq[j].result);
+                count++;
+                i = j;
+                continue;
+            }
+        }
+        emitQuad(q.op, q.arg1, q.arg2, q.result);
+        if (strcmp(q.op, "ENDF") == 0) {
+            caller = -1;
+        }
+    }
+    for (; label < oldln; label++) { // 指向序列末尾的标号
+        backpatch(oldl[label].name, quadnum);
+    }
+    free(oldq);
+    free(oldl);
+    return count;
+}
+
+// 判断操作数是否为数字常量（非空且全为数字）
+int isConstant(char *name) {
+    if (name[0] == '\0') {
+        return 0;
+    }
+    for (int i = 0; name[i] != '\0'; i++) {
+        if (!isdigit(name[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 删除while循环中可以证明不会越界的越界检查，返回删除的四元式个数
+// 识别的循环形如：(=, K, , i) … Lb: (<, i, C, Lt) (JMP, , , Lf) Lt: <循环体> (JMP, , , Lb) Lf:，其中K、C为常量，
+// 循环体中对i的赋值都是i = i + 常量（i只增不减，因此i >= 0），且在第一次给i赋值之前i < C（或i <= C）总成立，
+// 于是这之前对i的越界检查BND i, N只要N >= C（或N > C）就可以删除；循环体中的函数调用可能修改全局变量i，这时不做处理
+int eliminateBoundsChecks() {
+    struct InternTable where = {NULL, NULL, NULL, 0, 0, NULL, 0}; // 标号名散列表，sym为标号所指的四元式位置
+    for (int l = 0; l < labelnum; l++) {
+        int id = internToken(&where, labeltab[l].name, strlen(labeltab[l].name));
+        where.sym[id] = labeltab[l].quadpos;
+    }
+    char *dead = (char *)calloc(quadnum + 1, sizeof(char)); // 要删除的四元式
+    if (dead == NULL) { // 如果分配失败，报错并退出程序
+        error("Out of memory");
+    }
+    int count = 0; // 删除的越界检查个数
+    for (int l = 0; l < labelnum; l++) {
+        int p = labeltab[l].quadpos; // 循环条件的位置
+        if ((l > 0 && labeltab[l - 1].quadpos == p) || (l + 1 < labelnum && labeltab[l + 1].quadpos == p)) { // 还有别的标号指向循环条件，可能不经过初始化就进入循环
+            continue;
+        }
+        if (p + 2 >= quadnum) { // p为0时初始化只可能在之前的窗口中
+            continue;
+        }
+        struct Quadruple *cond = &quadtab[p]; // 循环条件
+        int strict = strcmp(cond->op, "<") == 0; // 是否为严格小于
+        if (!strict && strcmp(cond->op, "<=") != 0) {
+            continue;
+        }
+        char *var = cond->arg1; // 循环变量
+        int v = lookupSymbol(var);
+        if (v == -1 || symtab[v].size > 0 || !isConstant(cond->arg2) || strlen(cond->arg2) > 5) { // 循环变量必须是标量，上界必须是常量
+            continue;
+        }
+        if (strcmp(quadtab[p + 1].op, "JMP") != 0 || labelPosition(&where, cond->result) != p + 2) { // 条件为真时进入紧随其后的循环体
+            continue;
+        }
+        int e = p - 1; // 循环变量的初始化：进入循环前同一基本块中最后一次给i赋值
+        while (e >= 0 && !isBranch(quadtab[e]) && strcmp(quadtab[e].result, var) != 0 && strcmp(quadtab[e].op, "CALL") != 0) {
+            int label = findLabel(e);
+            if (label < labelnum && labeltab[label].quadpos == e) { // 基本块入口，可能从别处跳来
+                break;
+            }
+            e--;
+        }
+        if (e < 0 ? !carriedConstant(var) : strcmp(quadtab[e].op, "=") != 0 || strcmp(quadtab[e].result, var) != 0 || !isConstant(quadtab[e].arg1)) { // 循环变量必须在进入循环前赋常量初值（常量都是非负数）；流式模式下直线代码可能从已输出的窗口延续过来
+            continue;
+        }
+        int limit = atoi(cond->arg2) + (strict ? 0 : 1); // 循环体开头处i < limit
+        int q = p + 2; // 跳回循环条件的位置
+        while (q < quadnum && !(strcmp(quadtab[q].op, "JMP") == 0 && strcmp(quadtab[q].result, labeltab[l].name) == 0)) {
+            q++;
+        }
+        if (q == quadnum) {
+            continue;
+        }
+        int ok = 1; // 循环体中对i的赋值是否都是i = i + 常量
+        int first = q; // 循环体中第一次给i赋值的位置
+        for (int k = p + 2; k < q && ok; k++) {
+            struct Quadruple *quad = &quadtab[k];
+            if (strcmp(quad->op, "CALL") == 0 && symtab[v].scope == -1) { // 被调函数可能修改全局变量
+                ok = 0;
+            } else if (strcmp(quad->result, var) == 0 && !isBranch(*quad) && strcmp(quad->op, "[]=") != 0) { // 给i赋值
+                struct Quadruple *add = &quadtab[k - 1]; // 赋值之前计算i + 常量的四元式
+                if (strcmp(quad->op, "=") != 0 || strcmp(add->op, "+") != 0 || strcmp(add->result, quad->arg1) != 0 || strcmp(add->arg1, var) != 0 || !isConstant(add->arg2)) {
+                    ok = 0;
+                }
+                if (k < first) {
+                    first = k;
+                }
+            }
+        }
+        if (!ok) {
+            continue;
+        }
+        for (int k = p + 2; k < first; k++) {
+            struct Quadruple *quad = &quadtab[k];
+            if (strcmp(quad->op, "BND") != 0 || strcmp(quad->arg1, var) != 0 || atoi(quad->arg2) < limit || dead[k]) {
+                continue;
+            }
+            int safe = 1; // 检查所在的内层循环中是否没有给i赋值
+            for (int j = k + 1; j < q && safe && first < q; j++) { // 跳回到k之前的内层循环会在给i赋值之后再次执行检查
+                if (isBranch(quadtab[j]) && strcmp(quadtab[j].op, "RET") != 0 && strcmp(quadtab[j].op, "ENDF") != 0) { // 跳转四元式的结果字段是标号
+                    int target = labelPosition(&where, quadtab[j].result);
+                    if (target == -1 || (target <= k && j >= first)) {
+                        safe = 0;
+                    }
+                }
+            }
+            if (safe) {
+                dead[k] = 1;
+                count++;
+            }
+        }
+    }
+    if (count > 0) {
+        removeQuads(dead);
+    }
+    freeInterned(&where);
+    free(dead);
+    return count;
+}
+
+// 返回标号所指的四元式位置，不在标号表中时返回-1
+int labelPosition(struct InternTable *labels, char *name) {
+    int id = findInterned(labels, name, strlen(name));
+    return id == -1 ? -1 : labels->sym[id];
+}
+
+// 判断流式模式下已输出部分末尾的直线代码中最后一次给标量变量var赋的是否为常量
+int carriedConstant(char *var) {
+    int id = findInterned(&carried, var, strlen(var));
+    return id != -1 && carried.sym[id];
+}
+
+// 流式模式下输出窗口前调用：记录窗口末尾的直线代码（从最后一个基本块入口、跳转或调用之后开始）中各标量变量的最后一次赋值是否为常量，
+// 直线代码从窗口开头开始时与之前记录的合并，这样跨窗口的循环初始化与整体编译时同样可见；
+// 只记录用户声明的标量变量（临时变量和数组不会是循环变量），记录个数不超过符号个数，内存占用不随源程序增长
+void carryAssigns() {
+    int begin = quadnum; // 末尾直线代码的开始位置（与删除越界检查时向前查找初始化的范围一致）
+    int entry = 0; // 直线代码是否从基本块入口开始
+    while (begin > 0 && !isBranch(quadtab[begin - 1]) && strcmp(quadtab[begin - 1].op, "CALL") != 0) {
+        begin--;
+        int label = findLabel(begin);
+        if (label < labelnum && labeltab[label].quadpos == begin) {
+            entry = 1;
+            break;
+        }
+    }
+    if (begin > 0 || entry) { // 直线代码不是从之前的窗口延续下来的
+        freeInterned(&carried);
+        memset(&carried, 0, sizeof(struct InternTable));
+    }
+    for (int k = begin; k < quadnum; k++) {
+        struct Quadruple *quad = &quadtab[k];
+        if (quad->result[0] == '\0' || strcmp(quad->op, "[]=") == 0 || isTemp(quad->result)) {
+            continue;
+        }
+        int v = lookupSymbol(quad->result);
+        if (v == -1 || symtab[v].size > 0) { // 只记录标量变量
+            continue;
+        }
+        int id = internToken(&carried, quad->result, strlen(quad->result));
+        carried.sym[id] = strcmp(quad->op, "=") == 0 && isConstant(quad->arg1); // 重新赋非常量值时作废之前的记录
+    }
+}
+
+// 删除四元式序列中标记为dead的四元式，并把标号调整到删除后的位置
+void removeQuads(char *dead) {
+    int *map = (int *)malloc((quadnum + 1) * sizeof(int)); // 原位置对应的新位置
+    if (map == NULL) { // 如果分配失败，报错并退出程序
+        error("Out of memory");
+    }
+    int n = 0; // 保留的四元式个数
+    for (int i = 0; i < quadnum; i++) {
+        map[i] = n;
+        if (!dead[i]) {
+            quadtab[n++] = quadtab[i];
+        }
+    }
+    map[quadnum] = n;
+    for (int l = 0; l < labelnum; l++) {
+        labeltab[l].quadpos = map[labeltab[l].quadpos];
+    }
+    quadnum = n;
+    free(map);
+}
+
+// 按格式生成目标代码并追加到缓冲区中，空间不足时自动扩容
+void bufPrintf(struct CodeBuffer *buf, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(NULL, 0, fmt, ap); // 先计算格式化后的长度
+    va_end(ap);
+    if (buf->len + n + 1 > buf->cap) { // 如果空间不足，扩容到足够大
+        int cap = buf->cap ? buf->cap : CODESIZE;
+        while (buf->len + n + 1 > cap) {
+            cap *= 2;
+        }
+        buf->data = (char *)realloc(buf->data, cap);
+        if (buf->data == NULL) { // 如果分配失败，报错并退出程序
+            error("Out of memory");
+        }
+        buf->cap = cap;
+    }
+    va_start(ap, fmt);
+    vsnprintf(buf->data + buf->len, n + 1, fmt, ap); // 追加格式化后的目标代码
+    va_end(ap);
+    buf->len += n;
+}
+
 // 语义分析函数，检查源程序的语义正确性并填充符号表和四元式序列中的值和地址信息
 void semanticAnalysis() {
+    semanticRange(0, quadnum); // 对整个四元式序列进行语义检查和处理
+}
+
+// 对[begin, end)区间内的四元式进行语义检查和处理：为变量、数组和不能留在寄存器中的临时变量分配地址，检查操作数的种类
+void semanticRange(int begin, int end) {
+    scanTemps(begin, end); // 统计临时变量的定义和使用位置，决定哪些临时变量留在寄存器中
+    int func = -1; // 当前所在函数在符号表中的位置（-1表示顶层）
     // 遍历四元式序列，对每个四元式进行语义检查和处理
-    for (int i = 0; i < quadnum; i++) {
+    for (int i = begin; i < end; i++) {
         struct Quadruple quad = quadtab[i]; // 获取当前四元式
-        if (strcmp(quad.op, "DEC") == 0) { // 如果是DEC四元式，表示为标识符分配空间
+        if (strcmp(quad.op, "DEC") == 0 || strcmp(quad.op, "PARAM") == 0) { // 如果是DEC或PARAM四元式，表示为标识符分配空间
             int index = lookupSymbol(quad.result); // 查找符号表中是否有该标识符
-            if (index != -1) { // 如果找到了，设置其地址为当前的偏移量
+            int bytes = index != -1 && symtab[index].size > 0 ? 4 * symtab[index].size : 4; // 所占字节数（这里假设每个变量或数组元素占4个字节）
+            if (index != -1 && symtab[index].scope == -1) { // 如果是全局变量，设置其地址为全局数据区中当前的偏移量
                 symtab[index].address = offset;
-                offset += 4; // 增加偏移量（这里假设每个变量占4个字节）
+                offset += bytes; // 增加偏移量
+            } else if (index != -1) { // 如果是参数或局部变量，在所属函数的栈帧中分配空间（位于保存的$ra和$fp之下，数组的地址是第0个元素的地址）
+                int owner = symtab[index].scope;
+                symtab[owner].frame += bytes;
+                symtab[index].address = -(8 + symtab[owner].frame);
             } else { // 如果没有找到，说明是语义错误
                 error("Undeclared identifier");
             }
-        } else if (strcmp(quad.op, "=") == 0) { // 如果是赋值四元式，表示将表达式的结果赋给标识符
-            int index1 = lookupSymbol(quad.arg1); // 查找符号表中是否有第一个操作数（表达式的结果）
-            int index2 = lookupSymbol(quad.result); // 查找符号表中是否有结果（标识符）
-            if (index1 != -1 && index2 != -1) { // 如果都找到了，检查它们的类型是否匹配
-                if (symtab[index1].type == symtab[index2].type) { // 如果类型匹配，更新符号表中的值
-                    symtab[index2].value = symtab[index1].value;
-                } else { // 如果类型不匹配，说明是语义错误
-                    error("Type mismatch");
-                }
-            } else { // 如果有一个没有找到，说明是语义错误
-                error("Undeclared identifier");
+        } else if (strcmp(quad.op, "FUNC") == 0) { // 如果是FUNC四元式，表示函数入口，开始为函数的参数、局部变量和临时变量分配栈帧
+            int index = lookupSymbol(quad.result);
+            if (index != -1 && symtab[index].kind == SYM_FUNC) {
+                symtab[index].frame = 0;
+                func = index;
+            } else {
+                error("Undeclared function");
             }
+        } else if (strcmp(quad.op, "ENDF") == 0) { // 如果是ENDF四元式，表示函数结束
+            func = -1;
+        } else if (strcmp(quad.op, "CALL") == 0) { // 如果是CALL四元式，检查被调用的是否为函数
+            int index = lookupSymbol(quad.arg1);
+            if (index == -1 || symtab[index].kind != SYM_FUNC) {
+                error("Undeclared function");
+            }
+            if (quad.result[0] != '\0') { // 返回值存入的位置
+                checkTarget(quad.result);
+            }
+        } else if (strcmp(quad.op, "ARG") == 0) { // 如果是ARG四元式，检查实参
+            checkOperand(quad.arg1);
+        } else if (strcmp(quad.op, "BND") == 0) { // 如果是越界检查四元式，检查数组和下标，常量下标在编译时检查
+            int array = lookupSymbol(quad.result);
+            if (array == -1 || symtab[array].size == 0) { // 只能对数组取下标
+                error("Type mismatch");
+            }
+            checkOperand(quad.arg1);
+            if (isConstant(quad.arg1) && (strlen(quad.arg1) > 5 || atoi(quad.arg1) >= symtab[array].size)) { // 常量下标越界
+                error("Array index out of bounds");
+            }
+        } else if (strcmp(quad.op, "=[]") == 0 || strcmp(quad.op, "[]=") == 0) { // 如果是数组元素读写四元式，检查数组、下标和元素值
+            int load = quad.op[0] == '='; // 是否为读数组元素
+            int array = lookupSymbol(load ? quad.arg1 : quad.result); // 数组
+            if (array == -1 || symtab[array].size == 0) { // 只能对数组取下标
+                error("Type mismatch");
+            }
+            checkOperand(quad.arg2);
+            if (load) {
+                checkTarget(quad.result);
+            } else {
+                checkOperand(quad.arg1);
+            }
+        } else if (strcmp(quad.op, "=") == 0) { // 如果是赋值四元式，表示将表达式的结果赋给标识符
+            checkOperand(quad.arg1);
+            checkTarget(quad.result);
         } else if (strcmp(quad.op, "+") == 0 || strcmp(quad.op, "-") == 0 || strcmp(quad.op, "*") == 0 || strcmp(quad.op, "/") == 0 || strcmp(quad.op, "%") == 0) { // 如果是算术运算四元式，表示将两个操作数进行运算并将结果存入临时变量
-            int index1 = lookupSymbol(quad.arg1); // 查找符号表中是否有第一个操作数
-            int index2 = lookupSymbol(quad.arg2); // 查找符号表中是否有第二个操作数
-            int index3 = lookupSymbol(quad.result); // 查找符号表中是否有结果（临时变量）
-            if (index1 != -1 && index2 != -1 && index3 != -1) { // 如果都找到了，检查它们的类型是否匹配
-                if (symtab[index1].type == symtab[index2].type && symtab[index2].type == symtab[index3].type) { // 如果类型匹配，根据不同的运算符进行计算并更新符号表中的值
-                    switch (quad.op[0]) {
-                        case '+':
-                            symtab[index3].value = symtab[index1].value + symtab[index2].value;
-                            break;
-                        case '-':
-                            symtab[index3].value = symtab[index1].value - symtab[index2].value;
-                            break;
-                        case '*':
-                            symtab[index3].value = symtab[index1].value * symtab[index2].value;
-                            break;
-                        case '/':
-                            if (symtab[index2].value != 0) { // 检查除数是否为零
-                                symtab[index3].value = symtab[index1].value / symtab[index2].value;
-                            } else { // 如果除数为零，说明是语义错误
-                                error("Divide by zero");
-                            }
-                            break;
-                        case '%':
-                            if (symtab[index2].value != 0) { // 检查除数是否为零
-                                symtab[index3].value = symtab[index1].value % symtab[index2].value;
-                            } else { // 如果除数为零，说明是语义错误
-                                error("Divide by zero");
-                            }
-                            break;
-                        default:
-                            break;
-                    }
-                } else { // 如果类型不匹配，说明是语义错误
-                    error("Type mismatch");
-                }
-            } else { // 如果有一个没有找到，说明是语义错误
-                error("Undeclared identifier");
+            checkOperand(quad.arg1);
+            checkOperand(quad.arg2);
+            checkTarget(quad.result);
+            if ((quad.op[0] == '/' || quad.op[0] == '%') && isConstant(quad.arg2) && atoi(quad.arg2) == 0) { // 除数为常量0，说明是语义错误
+                error("Divide by zero");
             }
         } else if (strcmp(quad.op, "<") == 0 || strcmp(quad.op, "<=") == 0 || strcmp(quad.op, ">") == 0 || strcmp(quad.op, ">=") == 0 || strcmp(quad.op, "==") == 0 || strcmp(quad.op, "!=") == 0) { // 如果是关系运算四元式，表示将两个操作数进行比较并根据结果跳转到指定的标号
-            int index1 = lookupSymbol(quad.arg1); // 查找符号表中是否有第一个操作数
-            int index2 = lookupSymbol(quad.arg2); // 查找符号表中是否有第二个操作数
-            if (index1 != -1 && index2 != -1) { // 如果都找到了，检查它们的类型是否匹配
-                if (symtab[index1].type == symtab[index2].type) { // 如果类型匹配，根据不同的运算符进行比较并设置条件标志位
-                    switch (quad.op[0]) {
-                        case '<':
-                            flag = symtab[index1].value < symtab[index2].value;
-                            break;
-                        case '>':
-                            flag = symtab[index1].value > symtab[index2].value;
-                            break;
-                        case '=':
-                            flag = symtab[index1].value == symtab[index2].value;
-                            break;
-                        case '!':
-                            flag = symtab[index1].value != symtab[index2].value;
-                            break;
-                        default:
-                            break;
-                    }
-                } else { // 如果类型不匹配，说明是语义错误
-                    error("Type mismatch");
-                }
-            } else { // 如果有一个没有找到，说明是语义错误
-                error("Undeclared identifier");
-            }
+            checkOperand(quad.arg1);
+            checkOperand(quad.arg2);
         } else if (strcmp(quad.op, "JMP") == 0) { // 如果是无条件跳转四元式，表示跳转到指定的标号
             // 不需要进行语义检查和处理，直接跳转即可
         } else if (strcmp(quad.op, "RET") == 0) { // 如果是返回四元式，表示返回主函数或返回表达式的结果
-            int index = lookupSymbol(quad.arg1); // 查找符号表中是否有第一个操作数（表达式的结果）
-            if (index != -1) { // 如果找到了，检查其类型是否为int或char
-                if (symtab[index].type == ID || symtab[index].type == NUM) { // 如果类型为int或char，返回其值即可
-                    return symtab[index].value;
-                } else { // 如果类型不为int或char，说明是语义错误
-                    error("Invalid return type");
-                }
-            } else { // 如果没有找到，说明是返回主函数，不需要进行语义检查和处理
-                return 0;
+            if (quad.arg1[0] != '\0') { // 如果有返回值，检查其种类；返回之后的四元式仍需继续检查
+                checkOperand(quad.arg1);
             }
         } else { // 如果是其他情况，说明是语法错误（不应该出现）
             error("Invalid quadruple");
         }
+        if (!isBranch(quad) && isTemp(quad.result)) { // 为当前四元式定义的临时变量分配空间
+            allocTemp(quad.result, func);
+        }
     }
 }
 
-// 目标代码生成函数，根据四元式序列和符号表生成目标代码并输出到文件中
-void codeGeneration() {
-    FILE *fp = fopen("target.txt", "w"); // 打开目标代码文件
+// 统计[begin, end)区间内临时变量的定义位置和使用次数；只在下一个四元式中使用一次的临时变量留在寄存器$t2中，不分配存储空间
+void scanTemps(int begin, int end) {
+    int lo = -1, hi = -1; // 区间内临时变量编号的范围
+    for (int i = begin; i < end; i++) {
+        char *names[3] = {quadtab[i].arg1, quadtab[i].arg2, quadtab[i].result};
+        for (int k = 0; k < 3; k++) {
+            if (isTemp(names[k])) {
+                int n = tempNumber(names[k]);
+                lo = lo == -1 || n < lo ? n : lo;
+                hi = n > hi ? n : hi;
+            }
+        }
+    }
+    tempbase = lo == -1 ? 0 : lo;
+    tempnum = lo == -1 ? 0 : hi - lo + 1;
+    if (tempnum > tempcap) { // 如果临时变量表容量不足，扩容到足够大
+        tempcap = tempnum;
+        temptab = (struct TempInfo *)realloc(temptab, tempcap * sizeof(struct TempInfo));
+        if (temptab == NULL) { // 如果分配失败，报错并退出程序
+            error("Out of memory");
+        }
+    }
+    for (int k = 0; k < tempnum; k++) {
+        temptab[k].def = -1;
+        temptab[k].use = -1;
+        temptab[k].uses = 0;
+        temptab[k].inreg = 0;
+        temptab[k].address = 0;
+        temptab[k].scope = -1;
+    }
+    for (int i = begin; i < end; i++) {
+        struct Quadruple *quad = &quadtab[i];
+        if (isTemp(quad->arg1)) {
+            struct TempInfo *t = &temptab[tempNumber(quad->arg1) - tempbase];
+            t->uses++;
+            t->use = i;
+        }
+        if (isTemp(quad->arg2)) {
+            struct TempInfo *t = &temptab[tempNumber(quad->arg2) - tempbase];
+            t->uses++;
+            t->use = i;
+        }
+        if (!isBranch(*quad) && isTemp(quad->result)) {
+            temptab[tempNumber(quad->result) - tempbase].def = i;
+        }
+    }
+    for (int k = 0; k < tempnum; k++) { // 使用它的四元式紧随定义之后且不是基本块入口（没有标号指向它）时，值不经过内存
+        struct TempInfo *t = &temptab[k];
+        if (t->def != -1 && t->uses == 1 && t->use == t->def + 1) {
+            int label = findLabel(t->use);
+            t->inreg = label == labelnum || labeltab[label].quadpos != t->use;
+        }
+    }
+}
+
+// 为临时变量分配空间：顶层的临时变量位于全局数据区，函数中的临时变量位于函数的栈帧中；留在寄存器中的临时变量不分配空间
+void allocTemp(char *name, int func) {
+    struct TempInfo *t = &temptab[tempNumber(name) - tempbase];
+    t->scope = func;
+    if (t->inreg) {
+        return;
+    }
+    if (func == -1) {
+        t->address = offset;
+        offset += 4;
+    } else {
+        symtab[func].frame += 4;
+        t->address = -(8 + symtab[func].frame);
+    }
+}
+
+// 检查作为操作数使用的名字：必须是常量、临时变量或已声明的标量变量
+void checkOperand(char *name) {
+    if (isConstant(name)) {
+        return;
+    }
+    int index = lookupSymbol(name);
+    if (index != -1) {
+        if (symtab[index].kind == SYM_FUNC || symtab[index].size > 0) { // 函数名和数组不能作为标量使用
+            error("Type mismatch");
+        }
+    } else if (!isTemp(name)) { // 如果既不是变量也不是临时变量，说明是语义错误
+        error("Undeclared identifier");
+    }
+}
+
+// 检查被赋值的名字：必须是临时变量或已声明的标量变量
+void checkTarget(char *name) {
+    if (isConstant(name)) {
+        error("Invalid assignment");
+    }
+    checkOperand(name);
+}
+
+// 返回操作数的种类：常量、临时变量或变量
+enum OperandKind operandKind(char *name) {
+    if (isConstant(name)) {
+        return OPD_CONST;
+    }
+    return isTemp(name) ? OPD_TEMP : OPD_VAR;
+}
+
+// 返回变量或临时变量的地址，base返回寻址所用的基址寄存器
+int operandAddress(char *name, int *base) {
+    int index = lookupSymbol(name);
+    if (index != -1) {
+        *base = baseReg(index);
+        return symtab[index].address;
+    }
+    struct TempInfo *t = &temptab[tempNumber(name) - tempbase];
+    *base = t->scope == -1 ? R_GP : R_FP;
+    return t->address;
+}
+
+// 判断临时变量是否留在寄存器$t2中
+int inRegister(char *name) {
+    return operandKind(name) == OPD_TEMP && temptab[tempNumber(name) - tempbase].inreg;
+}
+
+// 如果操作数是能放进16位有符号立即数（且加1后仍能放进）的常量，返回1并把值存入value，否则返回0
+int immediate(char *name, int *value) {
+    if (!isConstant(name) || strlen(name) > 5 || atoi(name) > 32766) {
+        return 0;
+    }
+    *value = atoi(name);
+    return 1;
+}
+
+// 如果操作数是2的幂的常量，返回其以2为底的对数，否则返回-1
+int powerOfTwo(char *name) {
+    int value;
+    if (!immediate(name, &value) || value == 0 || (value & (value - 1)) != 0) {
+        return -1;
+    }
+    int k = 0;
+    while ((1 << k) != value) {
+        k++;
+    }
+    return k;
+}
+
+// 把操作数的值放到寄存器中并返回寄存器编号：常量用LI装入scratch（0直接用$zero），留在寄存器中的临时变量直接用$t2，其余从内存中加载到scratch中
+int useOperand(char *name, int scratch, struct Program *code) {
+    switch (operandKind(name)) {
+        case OPD_CONST:
+            if (atoi(name) == 0) {
+                return R_ZERO;
+            }
+            emitInstr(code, M_LI, scratch, -1, -1, atoi(name), NULL);
+            return scratch;
+        case OPD_TEMP:
+            if (inRegister(name)) {
+                return R_T2;
+            }
+            break;
+        default:
+            break;
+    }
+    int base;
+    int address = operandAddress(name, &base);
+    emitMemory(code, M_LW, scratch, address, base, base == R_GP);
+    return scratch;
+}
+
+// 把寄存器reg中的值存入name：留在寄存器中的临时变量放到$t2中，其余存入内存
+void defineResult(char *name, int reg, struct Program *code) {
+    if (inRegister(name)) {
+        if (reg != R_T2) {
+            emitInstr(code, M_MOVE, R_T2, reg, -1, 0, NULL);
+        }
+        return;
+    }
+    int base;
+    int address = operandAddress(name, &base);
+    emitMemory(code, M_SW, reg, address, base, base == R_GP);
+}
+
+// 在目标程序末尾追加一条指令：r为按汇编形式中出现顺序排列的寄存器编号（-1表示没有），label为跳转目标（NULL表示没有）
+void emitInstr(struct Program *code, enum MachineOp op, int r0, int r1, int r2, int imm, const char *label) {
+    if (code->num == code->cap) { // 如果指令数组已满，容量翻倍
+        code->cap = code->cap ? code->cap * 2 : CODESIZE;
+        code->code = (struct Instr *)realloc(code->code, code->cap * sizeof(struct Instr));
+        if (code->code == NULL) { // 如果分配失败，报错并退出程序
+            error("Out of memory");
+        }
+    }
+    struct Instr *in = &code->code[code->num++];
+    in->op = op;
+    in->r[0] = r0;
+    in->r[1] = r1;
+    in->r[2] = r2;
+    in->imm = imm;
+    in->data = 0;
+    in->ref = -1;
+    in->target = -1;
+    if (label != NULL) {
+        strcpy(in->label, label);
+    } else {
+        in->label[0] = '\0';
+    }
+}
+
+// 追加一条LW或SW指令，访问offset(base)；data为1表示offset是全局数据区中的地址
+void emitMemory(struct Program *code, enum MachineOp op, int reg, int offset, int base, int data) {
+    emitInstr(code, op, reg, base, -1, offset, NULL);
+    code->code[code->num - 1].data = data;
+}
+
+// 在目标程序末尾追加一个标号，指向下一条指令
+void emitLabel(struct Program *code, const char *name) {
+    if (code->labelnum == code->labelcap) { // 如果标号表已满，容量翻倍
+        code->labelcap = code->labelcap ? code->labelcap * 2 : LABELNUM;
+        code->labels = (struct Label *)realloc(code->labels, code->labelcap * sizeof(struct Label));
+        if (code->labels == NULL) { // 如果分配失败，报错并退出程序
+            error("Out of memory");
+        }
+    }
+    strcpy(code->labels[code->labelnum].name, name);
+    code->labels[code->labelnum].quadpos = code->num;
+    code->labelnum++;
+}
+
+// 把一段目标程序追加到另一段末尾，src中标号所指的指令序号相应后移
+void appendProgram(struct Program *dst, struct Program *src) {
+    for (int k = 0; k < src->labelnum; k++) { // 标号指向追加后的位置
+        emitLabel(dst, src->labels[k].name);
+        dst->labels[dst->labelnum - 1].quadpos = dst->num + src->labels[k].quadpos;
+    }
+    if (dst->num + src->num > dst->cap) { // 如果指令数组空间不足，容量翻倍
+        int cap = dst->cap ? dst->cap : CODESIZE;
+        while (dst->num + src->num > cap) {
+            cap *= 2;
+        }
+        dst->code = (struct Instr *)realloc(dst->code, cap * sizeof(struct Instr));
+        if (dst->code == NULL) { // 如果分配失败，报错并退出程序
+            error("Out of memory");
+        }
+        dst->cap = cap;
+    }
+    if (src->num > 0) {
+        memcpy(dst->code + dst->num, src->code, src->num * sizeof(struct Instr));
+    }
+    dst->num += src->num;
+}
+
+// 把跳转指令的目标标号解析为标号序号和指令序号，用驻留表按名字查找标号
+void resolveLabels(struct Program *prog) {
+    struct InternTable names = {NULL, NULL, NULL, 0, 0, NULL, 0}; // 标号名散列表，sym为标号在标号表中的序号
+    for (int k = 0; k < prog->labelnum; k++) {
+        int id = internToken(&names, prog->labels[k].name, strlen(prog->labels[k].name));
+        names.sym[id] = k;
+    }
+    for (int i = 0; i < prog->num; i++) {
+        struct Instr *in = &prog->code[i];
+        if (in->label[0] != '\0') {
+            int id = findInterned(&names, in->label, strlen(in->label));
+            if (id < 0) { // 如果标号未定义，报错并退出程序
+                error("Undefined label");
+            }
+            in->ref = names.sym[id];
+            in->target = prog->labels[in->ref].quadpos;
+        }
+    }
+    freeInterned(&names);
+}
+
+// 按汇编形式输出一条指令，格式由指令种类决定
+void formatInstr(struct Instr *in, struct CodeBuffer *buf) {
+    const char *op = machineOps[in->op];
+    switch (in->op) {
+    case M_LW: case M_SW: // 寄存器, 偏移量(基址寄存器)
+        bufPrintf(buf, "%s %s, %d(%s)\n", op, regNames[in->r[0]], in->imm, regNames[in->r[1]]);
+        break;
+    case M_LI: // 寄存器, 立即数
+        bufPrintf(buf, "%s %s, %d\n", op, regNames[in->r[0]], in->imm);
+        break;
+    case M_MOVE: case M_TEQ: // 两个寄存器
+        bufPrintf(buf, "%s %s, %s\n", op, regNames[in->r[0]], regNames[in->r[1]]);
+        break;
+    case M_ADDU: case M_SUBU: case M_MUL: case M_DIV: case M_REM: // 三个寄存器
+        bufPrintf(buf, "%s %s, %s, %s\n", op, regNames[in->r[0]], regNames[in->r[1]], regNames[in->r[2]]);
+        break;
+    case M_ADDIU: case M_SLTI: case M_SLTIU: case M_SLL: case M_SRA: case M_SRL: // 两个寄存器和立即数或移位量
+        bufPrintf(buf, "%s %s, %s, %d\n", op, regNames[in->r[0]], regNames[in->r[1]], in->imm);
+        break;
+    case M_BEQ: case M_BNE: case M_BLT: case M_BLE: case M_BGT: case M_BGE: // 两个寄存器和标号
+        bufPrintf(buf, "%s %s, %s, %s\n", op, regNames[in->r[0]], regNames[in->r[1]], in->label);
+        break;
+    case M_J: case M_JAL: // 标号或函数名
+        bufPrintf(buf, "%s %s\n", op, in->label);
+        break;
+    case M_JR: // 寄存器
+        bufPrintf(buf, "%s %s\n", op, regNames[in->r[0]]);
+        break;
+    }
+}
+
+// 按汇编形式输出一段目标程序：每个标号输出在它所指的指令之前，指向末尾的标号最后输出
+void formatProgram(struct Program *code, struct CodeBuffer *buf) {
+    int label = 0; // 下一个待输出的标号序号（标号按指令序号递增排列）
+    for (int i = 0; i < code->num; i++) {
+        while (label < code->labelnum && code->labels[label].quadpos == i) {
+            bufPrintf(buf, "%s:\n", code->labels[label].name);
+            label++;
+        }
+        formatInstr(&code->code[i], buf);
+    }
+    for (; label < code->labelnum; label++) {
+        bufPrintf(buf, "%s:\n", code->labels[label].name);
+    }
+}
+
+// 把汇编形式的目标代码写入文件
+void writeListing(const char *path, struct CodeBuffer *buf) {
+    FILE *fp = fopen(path, "w"); // 打开目标代码文件
     if (fp == NULL) { // 如果打开失败，报错并退出程序
         error("Cannot open target file");
     }
-    // 遍历四元式序列，对每个四元式生成对应的目标代码
-    for (int i = 0; i < quadnum; i++) {
-        struct Quadruple quad = quadtab[i]; // 获取当前四元式
-        if (strcmp(quad.op, "DEC") == 0) { // 如果是DEC四元式，表示为标识符分配空间
-            int index = lookupSymbol(quad.result); // 查找符号表中是否有该标识符
-            if (index != -1) { // 如果找到了，生成一条SUB指令，表示从栈顶减去4个字节（这里假设每个变量占4个字节）
-                fprintf(fp, "SUB $sp, $sp, 4\n");
-            } else { // 如果没有找到，说明是语义错误
-                error("Undeclared identifier");
+    fwrite(buf->data, 1, buf->len, fp);
+    fclose(fp); // 关闭目标代码文件
+}
+
+// 生成顶层代码的入口：建立栈帧保存返回地址（$ra会被函数调用改写，$s系列寄存器由调用者负责保存，不能占用）
+void genTopEntry(struct Program *code) {
+    emitInstr(code, M_ADDIU, R_SP, R_SP, -1, -TOPFRAME, NULL);
+    emitMemory(code, M_SW, R_RA, TOPFRAME - 4, R_SP, 0);
+}
+
+// 生成顶层代码的返回：先恢复返回地址再释放入口处建立的栈帧（$sp以下的内存随时可能被信号处理程序改写），然后返回
+void genTopExit(struct Program *code) {
+    emitMemory(code, M_LW, R_RA, TOPFRAME - 4, R_SP, 0);
+    emitInstr(code, M_ADDIU, R_SP, R_SP, -1, TOPFRAME, NULL);
+    emitInstr(code, M_JR, R_RA, -1, -1, 0, NULL);
+}
+
+// 生成函数的返回：函数体中$sp始终指向栈帧底部，先经$sp恢复返回地址和调用者的帧指针，再释放栈帧后返回调用者
+void genFuncExit(char *name, struct Program *code) {
+    int size = frameSize(lookupSymbol(name)); // 栈帧大小
+    emitMemory(code, M_LW, R_RA, size - 4, R_SP, 0);
+    emitMemory(code, M_LW, R_FP, size - 8, R_SP, 0);
+    emitInstr(code, M_ADDIU, R_SP, R_SP, -1, size, NULL);
+    emitInstr(code, M_JR, R_RA, -1, -1, 0, NULL);
+}
+
+// 为单个四元式生成目标代码并追加到目标程序中（只读访问符号表和临时变量表，可在多个线程中并发调用）
+// 操作数按种类选择指令：常量使用立即数形式，乘除2的幂改为移位，只在下一个四元式中使用的临时变量不经过内存
+void genQuad(int i, struct Program *code) {
+    struct Quadruple quad = quadtab[i]; // 获取当前四元式
+    if (strcmp(quad.op, "DEC") == 0) { // 如果是DEC四元式，表示为标识符分配空间
+        int index = lookupSymbol(quad.result); // 查找符号表中是否有该标识符（全局变量位于$gp所指的全局数据区，参数和局部变量的空间在函数入口处一次性分配，都不需要生成指令）
+        if (index == -1) { // 如果没有找到，说明是语义错误
+            error("Undeclared identifier");
+        }
+    } else if (strcmp(quad.op, "=") == 0) { // 如果是赋值四元式，表示将表达式的结果赋给标识符
+        if (isConstant(quad.arg1) && inRegister(quad.result)) { // 常量直接装入结果寄存器
+            emitInstr(code, M_LI, R_T2, -1, -1, atoi(quad.arg1), NULL);
+        } else {
+            defineResult(quad.result, useOperand(quad.arg1, R_T0, code), code);
+        }
+    } else if (strcmp(quad.op, "+") == 0 || strcmp(quad.op, "-") == 0 || strcmp(quad.op, "*") == 0 || strcmp(quad.op, "/") == 0 || strcmp(quad.op, "%") == 0) { // 如果是算术运算四元式，表示将两个操作数进行运算并将结果存入$t2，再存入结果位置
+        int k1, k2; // 常量操作数的值
+        int imm1 = immediate(quad.arg1, &k1), imm2 = immediate(quad.arg2, &k2); // 操作数是否为立即数
+        if (isConstant(quad.arg1) && isConstant(quad.arg2)) { // 两个操作数都是常量，在编译时计算
+            long long a = atoll(quad.arg1), b = atoll(quad.arg2), v = 0;
+            switch (quad.op[0]) {
+                case '+':
+                    v = a + b;
+                    break;
+                case '-':
+                    v = a - b;
+                    break;
+                case '*':
+                    v = a * b;
+                    break;
+                case '/':
+                    v = (int)a / (int)b;
+                    break;
+                case '%':
+                    v = (int)a % (int)b;
+                    break;
+                default:
+                    break;
             }
-        } else if (strcmp(quad.op, "=") == 0) { // 如果是赋值四元式，表示将表达式的结果赋给标识符
-            int index1 = lookupSymbol(quad.arg1); // 查找符号表中是否有第一个操作数（表达式的结果）
-            int index2 = lookupSymbol(quad.result); // 查找符号表中是否有结果（标识符）
-            if (index1 != -1 && index2 != -1) { // 如果都找到了，检查它们的类型是否匹配
-                if (symtab[index1].type == symtab[index2].type) { // 如果类型匹配，生成一条LW指令和一条SW指令，表示将表达式的结果从内存中加载到寄存器中，然后再存回到标识符的地址中
-                    fprintf(fp, "LW $t0, %d($sp)\n", symtab[index1].address);
-                    fprintf(fp, "SW $t0, %d($sp)\n", symtab[index2].address);
-                } else { // 如果类型不匹配，说明是语义错误
-                    error("Type mismatch");
-                }
-            } else { // 如果有一个没有找到，说明是语义错误
-                error("Undeclared identifier");
+            emitInstr(code, M_LI, R_T2, -1, -1, (int)v, NULL);
+        } else if (quad.op[0] == '+' && (imm1 || imm2)) { // 加常量，使用ADDIU
+            int r1 = imm2 ? useOperand(quad.arg1, R_T0, code) : useOperand(quad.arg2, R_T1, code);
+            emitInstr(code, M_ADDIU, R_T2, r1, -1, imm2 ? k2 : k1, NULL);
+        } else if (quad.op[0] == '-' && imm2) { // 减常量，使用ADDIU加上相反数
+            emitInstr(code, M_ADDIU, R_T2, useOperand(quad.arg1, R_T0, code), -1, -k2, NULL);
+        } else if (quad.op[0] == '*' && (powerOfTwo(quad.arg2) != -1 || powerOfTwo(quad.arg1) != -1)) { // 乘2的幂，改为左移
+            if (powerOfTwo(quad.arg2) != -1) {
+                emitInstr(code, M_SLL, R_T2, useOperand(quad.arg1, R_T0, code), -1, powerOfTwo(quad.arg2), NULL);
+            } else {
+                emitInstr(code, M_SLL, R_T2, useOperand(quad.arg2, R_T1, code), -1, powerOfTwo(quad.arg1), NULL);
             }
-        } else if (strcmp(quad.op, "+") == 0 || strcmp(quad.op, "-") == 0 || strcmp(quad.op, "*") == 0 || strcmp(quad.op, "/") == 0 || strcmp(quad.op, "%") == 0) { // 如果是算术运算四元式，表示将两个操作数进行运算并将结果存入临时变量
-            int index1 = lookupSymbol(quad.arg1); // 查找符号表中是否有第一个操作数
-            int index2 = lookupSymbol(quad.arg2); // 查找符号表中是否有第二个操作数
-            int index3 = lookupSymbol(quad.result); // 查找符号表中是否有结果（临时变量）
-            if (index1 != -1 && index2 != -1 && index3 != -1) { // 如果都找到了，检查它们的类型是否匹配
-                if (symtab[index1].type == symtab[index2].type && symtab[index2].type == symtab[index3].type) { // 如果类型匹配，生成两条LW指令和一条对应的算术指令，表示将两个操作数从内存中加载到寄存器中，然后进行运算并将结果存入另一个寄存器中
-                    fprintf(fp, "LW $t0, %d($sp)\n", symtab[index1].address);
-                    fprintf(fp, "LW $t1, %d($sp)\n", symtab[index2].address);
-                    switch (quad.op[0]) {
-                        case '+':
-                            fprintf(fp, "ADD $t2, $t0, $t1\n");
-                            break;
-                        case '-':
-                            fprintf(fp, "SUB $t2, $t0, $t1\n");
-                            break;
-                        case '*':
-                            fprintf(fp, "MUL $t2, $t0, $t1\n");
-                            break;
-                        case '/':
-                            fprintf(fp, "DIV $t2, $t0, $t1\n");
-                            break;
-                        case '%':
-                            fprintf(fp, "REM $t2, $t0, $t1\n");
-                            break;
-                        default:
-                            break;
-                    }
-                } else { // 如果类型不匹配，说明是语义错误
-                    error("Type mismatch");
-                }
-            } else { // 如果有一个没有找到，说明是语义错误
-                error("Undeclared identifier");
+        } else if (quad.op[0] == '/' && powerOfTwo(quad.arg2) != -1) { // 除以2的幂，改为算术右移（被除数为负数时先加上2^k-1，使结果向零取整）
+            int r1 = useOperand(quad.arg1, R_T0, code);
+            int k = powerOfTwo(quad.arg2);
+            if (k == 0) {
+                emitInstr(code, M_MOVE, R_T2, r1, -1, 0, NULL);
+            } else {
+                emitInstr(code, M_SRA, R_T1, r1, -1, 31, NULL);
+                emitInstr(code, M_SRL, R_T1, R_T1, -1, 32 - k, NULL);
+                emitInstr(code, M_ADDU, R_T1, r1, R_T1, 0, NULL);
+                emitInstr(code, M_SRA, R_T2, R_T1, -1, k, NULL);
             }
-        } else if (strcmp(quad.op, "<") == 0 || strcmp(quad.op, "<=") == 0 || strcmp(quad.op, ">") == 0 || strcmp(quad.op, ">=") == 0 || strcmp(quad.op, "==") == 0 || strcmp(quad.op, "!=") == 0) { // 如果是关系运算四元式，表示将两个操作数进行比较并根据结果跳转到指定的标号
-            int index1 = lookupSymbol(quad.arg1); // 查找符号表中是否有第一个操作数
-            int index2 = lookupSymbol(quad.arg2); // 查找符号表中是否有第二个操作数
-            if (index1 != -1 && index2 != -1) { // 如果都找到了，检查它们的类型是否匹配
-                if (symtab[index1].type == symtab[index2].type) { // 如果类型匹配，生成两条LW指令和一条对应的分支指令，表示将两个操作数从内存中加载到寄存器中，然后进行比较并根据结果跳转到指定的标号
-                    fprintf(fp, "LW $t0, %d($sp)\n", symtab[index1].address);
-                    fprintf(fp, "LW $t1, %d($sp)\n", symtab[index2].address);
-                    switch (quad.op[0]) {
-                        case '<':
-                            if (quad.op[1] == '=') {
-                                fprintf(fp, "BLE $t0, $t1, %s\n", quad.result);
-                            } else {
-                                fprintf(fp, "BLT $t0, $t1, %s\n", quad.result);
-                            }
-                            break;
-                        case '>':
-                            if (quad.op[1] == '=') {
-                                fprintf(fp, "BGE $t0, $t1, %s\n", quad.result);
-                            } else {
-                                fprintf(fp, "BGT $t0, $t1, %s\n", quad.result);
-                            }
-                            break;
-                        case '=':
-                            fprintf(fp, "BEQ $t0, $t1, %s\n", quad.result);
-                            break;
-                        case '!':
-                            fprintf(fp, "BNE $t0, $t1, %s\n", quad.result);
-                            break;
-                        default:
-                            break;
-                    }
-                } else { // 如果类型不匹配，说明是语义错误
-                    error("Type mismatch");
-                }
-            } else { // 如果有一个没有找到，说明是语义错误
-                error("Undeclared identifier");
+        } else { // 其余情况，两个操作数都放到寄存器中进行运算
+            int r1 = useOperand(quad.arg1, R_T0, code);
+            int r2 = useOperand(quad.arg2, R_T1, code);
+            switch (quad.op[0]) {
+                case '+':
+                    emitInstr(code, M_ADDU, R_T2, r1, r2, 0, NULL);
+                    break;
+                case '-':
+                    emitInstr(code, M_SUBU, R_T2, r1, r2, 0, NULL);
+                    break;
+                case '*':
+                    emitInstr(code, M_MUL, R_T2, r1, r2, 0, NULL);
+                    break;
+                case '/':
+                    emitInstr(code, M_DIV, R_T2, r1, r2, 0, NULL);
+                    break;
+                case '%':
+                    emitInstr(code, M_REM, R_T2, r1, r2, 0, NULL);
+                    break;
+                default:
+                    break;
             }
-        } else if (strcmp(quad.op, "JMP") == 0) { // 如果是无条件跳转四元式，表示跳转到指定的标号
-            fprintf(fp, "J %s\n", quad.result); // 生成一条J指令，表示跳转到指定的标号
-        } else if (strcmp(quad.op, "RET") == 0) { // 如果是返回四元式，表示返回主函数或返回表达式的结果
-            int index = lookupSymbol(quad.arg1); // 查找符号表中是否有第一个操作数（表达式的结果）
-            if (index != -1) { // 如果找到了，检查其类型是否为int或char
-                if (symtab[index].type == ID || symtab[index].type == NUM) { // 如果类型为int或char，生成一条LW指令和一条JR指令，表示将表达式的结果从内存中加载到寄存器中，然后返回主函数
-                    fprintf(fp, "LW $v0, %d($sp)\n", symtab[index].address);
-                    fprintf(fp, "JR $ra\n");
-                } else { // 如果类型不为int或char，说明是语义错误
-                    error("Invalid return type");
+        }
+        defineResult(quad.result, R_T2, code); // 把运算结果存入结果位置
+    } else if (strcmp(quad.op, "<") == 0 || strcmp(quad.op, "<=") == 0 || strcmp(quad.op, ">") == 0 || strcmp(quad.op, ">=") == 0 || strcmp(quad.op, "==") == 0 || strcmp(quad.op, "!=") == 0) { // 如果是关系运算四元式，表示将两个操作数进行比较并根据结果跳转到指定的标号
+        char op[3]; // 关系运算符（第一个操作数是常量时交换操作数并改变比较方向）
+        char *arg1 = quad.arg1, *arg2 = quad.arg2;
+        strcpy(op, quad.op);
+        if (isConstant(arg1) && !isConstant(arg2)) { // 常量放到第二个操作数，以便使用立即数形式
+            arg1 = quad.arg2;
+            arg2 = quad.arg1;
+            if (op[0] == '<') {
+                op[0] = '>';
+            } else if (op[0] == '>') {
+                op[0] = '<';
+            }
+        }
+        int k; // 常量操作数的值
+        if (isConstant(arg1) && isConstant(arg2)) { // 两个操作数都是常量，在编译时比较，条件成立时无条件跳转，否则不生成指令
+            long long a = atoll(arg1), b = atoll(arg2);
+            int taken = (strcmp(op, "<") == 0 && a < b) || (strcmp(op, "<=") == 0 && a <= b) || (strcmp(op, ">") == 0 && a > b) || (strcmp(op, ">=") == 0 && a >= b) || (strcmp(op, "==") == 0 && a == b) || (strcmp(op, "!=") == 0 && a != b);
+            if (taken) {
+                emitInstr(code, M_J, -1, -1, -1, 0, quad.result);
+            }
+        } else if (op[0] != '=' && op[0] != '!' && immediate(arg2, &k)) { // 与常量比较大小，使用SLTI（x <= k即x < k + 1）
+            int r1 = useOperand(arg1, R_T0, code);
+            int strict = op[1] != '='; // 是否为严格比较
+            emitInstr(code, M_SLTI, R_T1, r1, -1, (op[0] == '<') == strict ? k : k + 1, NULL);
+            emitInstr(code, op[0] == '<' ? M_BNE : M_BEQ, R_T1, R_ZERO, -1, 0, quad.result);
+        } else { // 其余情况，两个操作数都放到寄存器中进行比较（与0比较时直接使用$zero）
+            int r1 = useOperand(arg1, R_T0, code);
+            int r2 = useOperand(arg2, R_T1, code);
+            switch (op[0]) {
+                case '<':
+                    emitInstr(code, op[1] == '=' ? M_BLE : M_BLT, r1, r2, -1, 0, quad.result);
+                    break;
+                case '>':
+                    emitInstr(code, op[1] == '=' ? M_BGE : M_BGT, r1, r2, -1, 0, quad.result);
+                    break;
+                case '=':
+                    emitInstr(code, M_BEQ, r1, r2, -1, 0, quad.result);
+                    break;
+                case '!':
+                    emitInstr(code, M_BNE, r1, r2, -1, 0, quad.result);
+                    break;
+                default:
+                    break;
+            }
+        }
+    } else if (strcmp(quad.op, "JMP") == 0) { // 如果是无条件跳转四元式，表示跳转到指定的标号
+        emitInstr(code, M_J, -1, -1, -1, 0, quad.result); // 生成一条J指令，表示跳转到指定的标号
+    } else if (strcmp(quad.op, "RET") == 0) { // 如果是返回四元式，表示返回主函数或返回表达式的结果
+        if (quad.arg1[0] != '\0' && !returnsCall(i)) { // 如果有返回值，把它放到返回值寄存器中（直接返回调用结果时已在$v0中）
+            int reg = useOperand(quad.arg1, R_V0, code);
+            if (reg != R_V0) {
+                emitInstr(code, M_MOVE, R_V0, reg, -1, 0, NULL);
+            }
+        }
+        if (quad.result[0] != '\0') { // 如果在函数中，恢复调用者的栈帧后返回调用者
+            genFuncExit(quad.result, code);
+        } else { // 如果在顶层代码中，释放入口处建立的栈帧并返回
+            genTopExit(code);
+        }
+    } else if (strcmp(quad.op, "FUNC") == 0) { // 如果是FUNC四元式，表示函数入口，生成函数标号并建立栈帧
+        int index = lookupSymbol(quad.result);
+        int size = frameSize(index); // 栈帧大小
+        emitLabel(code, quad.result);
+        emitInstr(code, M_ADDIU, R_SP, R_SP, -1, -size, NULL); // 分配栈帧
+        emitMemory(code, M_SW, R_RA, size - 4, R_SP, 0); // 保存返回地址
+        emitMemory(code, M_SW, R_FP, size - 8, R_SP, 0); // 保存调用者的帧指针
+        emitInstr(code, M_ADDIU, R_FP, R_SP, -1, size, NULL); // $fp指向栈帧顶部（即调用前的$sp）
+    } else if (strcmp(quad.op, "PARAM") == 0) { // 如果是PARAM四元式，表示把参数寄存器保存到参数的栈帧位置
+        int index = lookupSymbol(quad.result);
+        if (index != -1) {
+            emitMemory(code, M_SW, R_A0 + atoi(quad.arg2), symtab[index].address, R_FP, 0);
+        } else {
+            error("Undeclared identifier");
+        }
+    } else if (strcmp(quad.op, "ARG") == 0) { // 如果是ARG四元式，表示把实参传入参数寄存器
+        int reg = R_A0 + atoi(quad.arg2); // 参数寄存器
+        int value = useOperand(quad.arg1, reg, code);
+        if (value != reg) {
+            emitInstr(code, M_MOVE, reg, value, -1, 0, NULL);
+        }
+    } else if (strcmp(quad.op, "CALL") == 0) { // 如果是CALL四元式，表示调用函数并保存返回值
+        emitInstr(code, M_JAL, -1, -1, -1, 0, quad.arg1);
+        if (quad.result[0] != '\0' && !(i + 1 < quadnum && returnsCall(i + 1))) { // 如果需要返回值，把$v0存入结果位置（紧接着原样返回时留在$v0中）
+            defineResult(quad.result, R_V0, code);
+        }
+    } else if (strcmp(quad.op, "BND") == 0) { // 如果是BND四元式，表示检查下标是否在[0, size)之内（按无符号数比较，负数也越界），越界时陷入；常量下标已在编译时检查
+        if (!isConstant(quad.arg1)) {
+            emitInstr(code, M_SLTIU, R_T1, useOperand(quad.arg1, R_T0, code), -1, atoi(quad.arg2), NULL);
+            emitInstr(code, M_TEQ, R_T1, R_ZERO, -1, 0, NULL);
+        }
+    } else if (strcmp(quad.op, "=[]") == 0 || strcmp(quad.op, "[]=") == 0) { // 如果是数组元素读写四元式，常量下标直接算出偏移量，否则先把下标乘以4加上基址寄存器，再以数组地址为偏移量访问元素
+        int load = quad.op[0] == '='; // 是否为读数组元素
+        int array = lookupSymbol(load ? quad.arg1 : quad.result); // 数组
+        int offset = symtab[array].address; // 元素的偏移量
+        int base = baseReg(array); // 元素的基址寄存器
+        int data = base == R_GP; // 偏移量是否为全局数据区中的地址
+        if (isConstant(quad.arg2)) {
+            offset += 4 * atoi(quad.arg2);
+        } else {
+            emitInstr(code, M_SLL, R_T0, useOperand(quad.arg2, R_T0, code), -1, 2, NULL);
+            emitInstr(code, M_ADDU, R_T0, R_T0, base, 0, NULL);
+            base = R_T0;
+        }
+        if (load) {
+            emitMemory(code, M_LW, R_T2, offset, base, data);
+            defineResult(quad.result, R_T2, code);
+        } else {
+            emitMemory(code, M_SW, useOperand(quad.arg1, R_T1, code), offset, base, data);
+        }
+    } else if (strcmp(quad.op, "ENDF") == 0) { // 如果是ENDF四元式，表示执行到函数末尾，恢复调用者的栈帧后返回
+        genFuncExit(quad.result, code);
+    } else { // 如果是其他情况，说明是语法错误（不应该出现）
+        error("Invalid quadruple");
+    }
+}
+
+// 为[begin, end)区间内的四元式及指向它们的标号生成目标代码，label为区间内第一个标号的序号，返回下一个待输出标号的序号
+int genRange(int begin, int end, int label, struct Program *code) {
+    for (int i = begin; i < end; i++) {
+        while (label < labelnum && labeltab[label].quadpos == i) { // 先输出指向当前四元式的所有标号
+            emitLabel(code, labeltab[label].name);
+            label++;
+        }
+        genQuad(i, code); // 再生成当前四元式的目标代码
+    }
+    return label;
+}
+
+// 判断第i个四元式是否为直接返回前一个CALL四元式的结果（结果是留在寄存器中的临时变量，只在返回时使用）
+int returnsCall(int i) {
+    return i > 0 && strcmp(quadtab[i].op, "RET") == 0 && strcmp(quadtab[i - 1].op, "CALL") == 0 && inRegister(quadtab[i].arg1) && strcmp(quadtab[i - 1].result, quadtab[i].arg1) == 0;
+}
+
+// 返回变量寻址所用的基址寄存器：全局变量相对于$gp，参数和局部变量相对于$fp
+int baseReg(int index) {
+    return symtab[index].scope == -1 ? R_GP : R_FP;
+}
+
+// 返回函数的栈帧大小：保存的$ra和$fp加上参数和局部变量，按8字节对齐
+int frameSize(int func) {
+    return (8 + symtab[func].frame + 7) / 8 * 8;
+}
+
+// 判断四元式是否为跳转或返回（基本块的结束），是则返回1，否则返回0
+int isBranch(struct Quadruple quad) {
+    return strcmp(quad.op, "JMP") == 0 || strcmp(quad.op, "RET") == 0 || strcmp(quad.op, "ENDF") == 0 || strcmp(quad.op, "<") == 0 || strcmp(quad.op, "<=") == 0 || strcmp(quad.op, ">") == 0 || strcmp(quad.op, ">=") == 0 || strcmp(quad.op, "==") == 0 || strcmp(quad.op, "!=") == 0;
+}
+
+// 返回标号表中第一个位置不小于quadpos的标号序号（标号表按位置递增排列，二分查找）
+int findLabel(int quadpos) {
+    int lo = 0, hi = labelnum;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (labeltab[mid].quadpos < quadpos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// 在基本块边界处把四元式序列划分为若干分区，每个分区大小尽量接近quadnum/maxparts，返回分区个数
+int partitionQuads(struct CodePartition *parts, int maxparts) {
+    int target = (quadnum + maxparts - 1) / maxparts; // 每个分区的目标大小
+    int count = 0; // 已划分的分区个数
+    int begin = 0; // 当前分区的起始位置
+    int label = 0; // 下一个尚未处理的标号序号
+    for (int i = 1; i < quadnum; i++) {
+        while (label < labelnum && labeltab[label].quadpos < i) { // 跳过位置在i之前的标号
+            label++;
+        }
+        int leader = isBranch(quadtab[i - 1]) || (label < labelnum && labeltab[label].quadpos == i); // 跳转之后的四元式和标号所指的四元式都是基本块的入口
+        if (leader && i - begin >= target && count < maxparts - 1) { // 只在基本块入口处切分，保证基本块不被拆开
+            parts[count].begin = begin;
+            parts[count].end = i;
+            count++;
+            begin = i;
+        }
+    }
+    parts[count].begin = begin; // 最后一个分区延伸到四元式序列末尾
+    parts[count].end = quadnum;
+    count++;
+    for (int k = 0; k < count; k++) { // 记录每个分区内第一个标号的序号，并初始化分区目标程序
+        parts[k].label = findLabel(parts[k].begin);
+        memset(&parts[k].code, 0, sizeof(struct Program));
+        memset(&parts[k].text, 0, sizeof(struct CodeBuffer));
+    }
+    return count;
+}
+
+// 代码生成工作线程的参数
+struct CodegenTask {
+    struct CodePartition *parts; // 分区数组
+    int partnum; // 分区个数
+    int first; // 本线程处理的第一个分区
+    int stride; // 分区步长（即线程数）
+};
+
+// 代码生成工作线程函数，按步长依次为分到的分区生成目标代码到各自的目标程序中，需要时同时按汇编形式输出
+void *codegenWorker(void *arg) {
+    struct CodegenTask *task = (struct CodegenTask *)arg;
+    for (int k = task->first; k < task->partnum; k += task->stride) {
+        struct CodePartition *part = &task->parts[k];
+        genRange(part->begin, part->end, part->label, &part->code);
+        if (keepListing) { // 分区内指向分区末尾的标号就是下一分区开头的标号，各分区的汇编代码可以直接拼接
+            formatProgram(&part->code, &part->text);
+        }
+    }
+    return NULL;
+}
+
+// 目标代码生成函数，根据四元式序列和符号表生成目标程序，需要时输出汇编形式的目标代码
+void codeGeneration() {
+    struct CodeBuffer listing = {NULL, 0, 0}; // 汇编形式的目标代码
+    genTopEntry(&target); // 顶层代码的入口
+    int nthreads = codegenThreads > MAXTHREADS ? MAXTHREADS : codegenThreads; // 实际使用的线程数
+    if (nthreads <= 1 || quadnum < PARALLELMIN) { // 串行生成：整个四元式序列作为一个分区
+        genRange(0, quadnum, 0, &target);
+        if (keepListing) {
+            formatProgram(&target, &listing);
+        }
+    } else { // 并行生成：在基本块边界处划分分区，各线程生成到线程局部目标程序，再按分区顺序拼接
+        int maxparts = nthreads * PARTSPERTHREAD;
+        struct CodePartition *parts = (struct CodePartition *)malloc(maxparts * sizeof(struct CodePartition));
+        if (parts == NULL) { // 如果分配失败，报错并退出程序
+            error("Out of memory");
+        }
+        int partnum = partitionQuads(parts, maxparts);
+        if (keepListing) { // 顶层代码的入口先输出，各分区的汇编代码由工作线程生成
+            formatProgram(&target, &listing);
+        }
+        pthread_t threads[MAXTHREADS];
+        struct CodegenTask tasks[MAXTHREADS];
+        for (int t = 0; t < nthreads; t++) { // 启动工作线程
+            tasks[t].parts = parts;
+            tasks[t].partnum = partnum;
+            tasks[t].first = t;
+            tasks[t].stride = nthreads;
+            if (pthread_create(&threads[t], NULL, codegenWorker, &tasks[t]) != 0) {
+                error("Cannot create thread");
+            }
+        }
+        for (int t = 0; t < nthreads; t++) { // 等待所有工作线程结束
+            pthread_join(threads[t], NULL);
+        }
+        for (int k = 0; k < partnum; k++) { // 按分区顺序拼接，结果与串行生成完全一致
+            appendProgram(&target, &parts[k].code);
+            if (keepListing) {
+                bufBytes(&listing, parts[k].text.data, parts[k].text.len);
+            }
+            free(parts[k].code.code);
+            free(parts[k].code.labels);
+            free(parts[k].text.data);
+        }
+        free(parts);
+    }
+    struct Program tail = {NULL, 0, 0, NULL, 0, 0}; // 顶层代码的结尾
+    for (int label = findLabel(quadnum); label < labelnum; label++) { // 指向序列末尾的标号
+        emitLabel(&tail, labeltab[label].name);
+    }
+    genTopExit(&tail); // 执行到代码末尾时同样返回
+    appendProgram(&target, &tail);
+    if (keepListing) {
+        formatProgram(&tail, &listing);
+        writeListing("target.txt", &listing);
+        free(listing.data);
+    }
+    free(tail.code);
+    free(tail.labels);
+}
+
+
+
+// 按名字查找优化遍，返回其在优化遍表中的位置，如果不存在则报错并退出程序
+int findPass(char *name) {
+    for (int k = 0; k < passnum; k++) {
+        if (strcmp(passes[k].name, name) == 0) {
+            return k;
+        }
+    }
+    error("Unknown pass");
+    return -1;
+}
+
+// 按注册顺序运行优化遍表中级别不高于optLevel且未被关闭的优化遍，累计运行时间和改动次数，并按需打印运行前后的四元式序列
+void runPasses() {
+    for (int k = 0; k < passnum; k++) {
+        struct Pass *pass = &passes[k];
+        if (pass->level > optLevel || pass->disabled) { // 优化级别不够或已被关闭，跳过
+            continue;
+        }
+        if (pass->dumpBefore) {
+            printf("IR before %s:\n", pass->name);
+            printQuadList();
+        }
+        double start = wallTime();
+        pass->changes += pass->run();
+        pass->seconds += wallTime() - start;
+        pass->runs++;
+        if (pass->dumpAfter) {
+            printf("IR after %s:\n", pass->name);
+            printQuadList();
+        }
+    }
+}
+
+// 打印各优化遍的运行次数、改动次数和运行时间，以及各编译阶段的运行时间（输出到标准错误，不与记号信息混在一起）
+void printPassTimes() {
+    double total = 0.0; // 所有优化遍的总运行时间
+    fprintf(stderr, "%-10s %6s %8s %10s\n", "pass", "runs", "changes", "time(ms)");
+    for (int k = 0; k < passnum; k++) {
+        fprintf(stderr, "%-10s %6d %8d %10.3f\n", passes[k].name, passes[k].runs, passes[k].changes, passes[k].seconds * 1000.0);
+        total += passes[k].seconds;
+    }
+    fprintf(stderr, "%-10s %6s %8s %10.3f\n", "total", "", "", total * 1000.0);
+    fprintf(stderr, "%-10s %26s\n", "stage", "time(ms)");
+    for (int k = 0; k < STAGENUM; k++) {
+        fprintf(stderr, "%-10s %26.3f\n", stageNames[k], stageSeconds[k] * 1000.0);
+        total += stageSeconds[k];
+    }
+    fprintf(stderr, "%-10s %26.3f\n", "compile", total * 1000.0); // 优化遍与各阶段之和
+}
+
+// 返回当前的单调时钟时间（秒），用于统计优化遍的运行时间
+double wallTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 流式模式下对窗口中的四元式进行语义分析和代码生成并立即输出，然后清空窗口；final为1时同时输出指向末尾的标号
+void flushQuads(int final) {
+    double start = wallTime();
+    runPasses(); // 对窗口中的四元式运行优化遍（各优化遍单独计时）
+    double sema = wallTime(); // 跨窗口的赋值记录计入语义分析时间，从语法分析时间中减去的部分都有归属
+    carryAssigns(); // 下一个窗口中的循环可能在本窗口末尾初始化
+    semanticRange(0, quadnum); // 对窗口中的四元式进行语义检查和处理
+    double codegen = wallTime();
+    stageSeconds[ST_SEMA] += codegen - sema;
+    static int entered = 0; // 是否已生成顶层代码入口
+    streamCode.num = 0; // 复用窗口目标程序，内存占用不随源程序增长
+    streamCode.labelnum = 0;
+    if (!entered) {
+        genTopEntry(&streamCode);
+        entered = 1;
+    }
+    int label = genRange(0, quadnum, 0, &streamCode); // 生成窗口中的四元式及其标号的目标代码
+    int kept = 0; // 保留下来的标号个数
+    for (; label < labelnum; label++) { // 指向窗口末尾的标号属于下一个窗口的第一条四元式，移到标号表开头
+        if (final) {
+            emitLabel(&streamCode, labeltab[label].name);
+        } else {
+            labeltab[kept] = labeltab[label];
+            labeltab[kept].quadpos -= quadnum;
+            kept++;
+        }
+    }
+    labelnum = kept;
+    if (final) { // 执行到代码末尾时同样返回
+        genTopExit(&streamCode);
+    }
+    quadnum = 0; // 清空窗口
+    if (keepListing) {
+        streamBuf.len = 0; // 复用缓冲区
+        formatProgram(&streamCode, &streamBuf);
+        fwrite(streamBuf.data, 1, streamBuf.len, streamOut);
+        fflush(streamOut); // 立即输出，尽早得到目标代码
+    }
+    if (showStats || runTarget || emitObject) { // 模拟执行和目标文件需要整个目标程序
+        appendProgram(&target, &streamCode);
+    }
+    double end = wallTime();
+    stageSeconds[ST_CODEGEN] += end - codegen;
+    stageSeconds[ST_PARSE] -= end - start; // 输出窗口发生在语法分析过程中，不计入语法分析时间
+}
+
+// 检查模拟执行时访问的内存地址，返回对应的字序号
+int memoryWord(int address, int size) {
+    if (address < 0 || address >= size || address % 4 != 0) { // 如果越界或未对齐，报错并退出程序
+        error("Invalid memory access");
+    }
+    return address / 4;
+}
+
+// 模拟执行目标代码：全局数据区从地址0开始，栈位于全局数据区之上；执行到顶层的JR $ra或代码末尾时结束，返回执行的指令数，result返回$v0的值
+long long simulate(struct Program *prog, int data, int *result) {
+    int size = (data + STACKSIZE + 3) / 4 * 4; // 模拟内存大小（字节）
+    int *mem = (int *)calloc(size / 4, sizeof(int)); // 模拟内存
+    if (mem == NULL) { // 如果分配失败，报错并退出程序
+        error("Out of memory");
+    }
+    int reg[32] = {0}; // 寄存器
+    reg[28] = 0; // $gp指向全局数据区
+    reg[29] = reg[30] = size; // $sp和$fp指向栈底
+    reg[31] = -1; // 顶层代码的返回地址，跳转到这里表示程序结束
+    long long steps = 0; // 执行的指令数
+    int pc = 0; // 下一条指令的序号
+    while (pc != -1 && pc != prog->num) {
+        if (pc < 0 || pc > prog->num) { // 如果跳转到代码之外，报错并退出程序
+            error("Invalid jump target");
+        }
+        if (++steps > SIMSTEPS) { // 如果执行的指令过多，可能是死循环
+            error("Simulation step limit exceeded");
+        }
+        struct Instr *in = &prog->code[pc++];
+        int *r = in->r;
+        switch (in->op) {
+            case M_LW:
+                reg[r[0]] = mem[memoryWord(reg[r[1]] + in->imm, size)];
+                break;
+            case M_SW:
+                mem[memoryWord(reg[r[1]] + in->imm, size)] = reg[r[0]];
+                break;
+            case M_LI:
+                reg[r[0]] = in->imm;
+                break;
+            case M_MOVE:
+                reg[r[0]] = reg[r[1]];
+                break;
+            case M_ADDU:
+                reg[r[0]] = (int)((unsigned)reg[r[1]] + (unsigned)reg[r[2]]);
+                break;
+            case M_SUBU:
+                reg[r[0]] = (int)((unsigned)reg[r[1]] - (unsigned)reg[r[2]]);
+                break;
+            case M_MUL:
+                reg[r[0]] = (int)((unsigned)reg[r[1]] * (unsigned)reg[r[2]]);
+                break;
+            case M_DIV:
+            case M_REM:
+                if (reg[r[2]] == 0) { // 如果除数为零，报错并退出程序
+                    error("Divide by zero");
+                }
+                if (reg[r[1]] == (int)0x80000000 && reg[r[2]] == -1) { // 溢出时商为被除数，余数为0
+                    reg[r[0]] = in->op == M_DIV ? reg[r[1]] : 0;
+                } else {
+                    reg[r[0]] = in->op == M_DIV ? reg[r[1]] / reg[r[2]] : reg[r[1]] % reg[r[2]];
                 }
-            } else { // 如果没有找到，说明是返回主函数，生成一条JR指令，表示返回主函数
-                fprintf(fp, "JR $ra\n");
+                break;
+            case M_ADDIU:
+                reg[r[0]] = (int)((unsigned)reg[r[1]] + (unsigned)in->imm);
+                break;
+            case M_SLTI:
+                reg[r[0]] = reg[r[1]] < in->imm;
+                break;
+            case M_SLTIU:
+                reg[r[0]] = (unsigned)reg[r[1]] < (unsigned)in->imm;
+                break;
+            case M_SLL:
+                reg[r[0]] = (int)((unsigned)reg[r[1]] << in->imm);
+                break;
+            case M_SRA:
+                reg[r[0]] = reg[r[1]] >> in->imm;
+                break;
+            case M_SRL:
+                reg[r[0]] = (int)((unsigned)reg[r[1]] >> in->imm);
+                break;
+            case M_TEQ:
+                if (reg[r[0]] == reg[r[1]]) { // 越界检查失败
+                    error("Trap: array index out of bounds");
+                }
+                break;
+            case M_BEQ:
+                pc = reg[r[0]] == reg[r[1]] ? in->target : pc;
+                break;
+            case M_BNE:
+                pc = reg[r[0]] != reg[r[1]] ? in->target : pc;
+                break;
+            case M_BLT:
+                pc = reg[r[0]] < reg[r[1]] ? in->target : pc;
+                break;
+            case M_BLE:
+                pc = reg[r[0]] <= reg[r[1]] ? in->target : pc;
+                break;
+            case M_BGT:
+                pc = reg[r[0]] > reg[r[1]] ? in->target : pc;
+                break;
+            case M_BGE:
+                pc = reg[r[0]] >= reg[r[1]] ? in->target : pc;
+                break;
+            case M_J:
+                pc = in->target;
+                break;
+            case M_JAL:
+                reg[31] = pc;
+                pc = in->target;
+                break;
+            case M_JR:
+                pc = reg[r[0]];
+                break;
+            default:
+                break;
+        }
+        reg[0] = 0; // $zero恒为0
+    }
+    free(mem);
+    *result = reg[2];
+    return steps;
+}
+
+// 返回所有函数栈帧大小之和（字节）
+int totalFrameSize() {
+    int total = 0;
+    for (int i = 0; i < symnum; i++) {
+        if (symtab[i].kind == SYM_FUNC) {
+            total += frameSize(i);
+        }
+    }
+    return total;
+}
+
+// 把字节序列追加到缓冲区中，空间不足时自动扩容
+void bufBytes(struct CodeBuffer *buf, const void *data, int n) {
+    if (n == 0) { // 空的字节序列（如空串表）的data可能为NULL，不能传给memcpy
+        return;
+    }
+    if (buf->len + n > buf->cap) { // 如果空间不足，扩容到足够大
+        int cap = buf->cap ? buf->cap : CODESIZE;
+        while (buf->len + n > cap) {
+            cap *= 2;
+        }
+        buf->data = (char *)realloc(buf->data, cap);
+        if (buf->data == NULL) { // 如果分配失败，报错并退出程序
+            error("Out of memory");
+        }
+        buf->cap = cap;
+    }
+    memcpy(buf->data + buf->len, data, n);
+    buf->len += n;
+}
+
+// 按大端字节序把一个32位字追加到缓冲区中
+void bufWord(struct CodeBuffer *buf, unsigned word) {
+    unsigned char bytes[4] = {word >> 24, word >> 16, word >> 8, word};
+    bufBytes(buf, bytes, 4);
+}
+
+// 按大端字节序把一个16位半字追加到缓冲区中
+void bufHalf(struct CodeBuffer *buf, unsigned half) {
+    unsigned char bytes[2] = {half >> 8, half};
+    bufBytes(buf, bytes, 2);
+}
+
+// 把一个机器指令字追加到代码段中
+void emitWord(struct ObjectCode *obj, unsigned word) {
+    if (obj->num == obj->cap) { // 如果代码段已满，容量翻倍
+        obj->cap = obj->cap ? obj->cap * 2 : CODESIZE;
+        obj->words = (unsigned *)realloc(obj->words, obj->cap * sizeof(unsigned));
+        if (obj->words == NULL) { // 如果分配失败，报错并退出程序
+            error("Out of memory");
+        }
+    }
+    obj->words[obj->num++] = word;
+}
+
+// 编码R型指令（操作码为0，或SPECIAL2指令由调用者加上操作码）
+unsigned encodeR(int rs, int rt, int rd, int shamt, int funct) {
+    return (unsigned)rs << 21 | (unsigned)rt << 16 | (unsigned)rd << 11 | (unsigned)shamt << 6 | (unsigned)funct;
+}
+
+// 编码I型指令，立即数取低16位
+unsigned encodeI(int opcode, int rs, int rt, int imm) {
+    return (unsigned)opcode << 26 | (unsigned)rs << 21 | (unsigned)rt << 16 | ((unsigned)imm & 0xffff);
+}
+
+// 判断整数能否放进16位有符号立即数字段
+int fitsImm16(int value) {
+    return value >= -32768 && value <= 32767;
+}
+
+// 把32位常量装入寄存器reg：能放进16位立即数时用一条ADDIU，否则用LUI和ORI
+void encodeLoadImm(int reg, int value, struct ObjectCode *obj) {
+    if (fitsImm16(value)) {
+        emitWord(obj, encodeI(0x09, 0, reg, value)); // ADDIU reg, $zero, value
+    } else {
+        emitWord(obj, encodeI(0x0f, 0, reg, (unsigned)value >> 16)); // LUI reg, 高16位
+        if (value & 0xffff) {
+            emitWord(obj, encodeI(0x0d, reg, reg, value)); // ORI reg, reg, 低16位
+        }
+    }
+}
+
+// 编码条件跳转指令及其延迟槽：偏移量为目标相对于延迟槽的字数；pos为NULL时只占位
+void encodeBranch(int opcode, int rs, int rt, int target, int *pos, struct ObjectCode *obj) {
+    int disp = pos != NULL ? pos[target] - (obj->num + 1) : 0; // 跳转偏移量（字）
+    if (!fitsImm16(disp)) { // 如果跳转距离超出16位偏移量的范围，报错并退出程序
+        error("Branch out of range");
+    }
+    emitWord(obj, encodeI(opcode, rs, rt, disp));
+    emitWord(obj, 0); // 延迟槽：NOP
+}
+
+// 把目标程序的第i条指令编码为机器指令字（汇编伪指令展开为真实指令，跳转指令后加延迟槽）追加到代码段中；
+// pos为各条指令展开后的字地址，为NULL时只计算展开后的长度；symbols为各标号在符号表中的序号
+void encodeInstr(struct Program *prog, int i, int *pos, int *symbols, struct ObjectCode *obj) {
+    struct Instr *in = &prog->code[i];
+    int *r = in->r;
+    switch (in->op) {
+        case M_LW:
+        case M_SW:
+            if (in->data) { // 全局数据区中的地址相对于$gp，由链接器按R_MIPS_GPREL16填写，偏移量作为加数保留在指令中
+                if (!fitsImm16(in->imm)) { // 如果超出$gp相对寻址的范围，报错并退出程序
+                    error("Static data too large for the small data section");
+                }
+                if (pos != NULL) {
+                    addReloc(obj, R_MIPS_GPREL16, obj->datasym);
+                }
+                emitWord(obj, encodeI(in->op == M_LW ? 0x23 : 0x2b, r[1], r[0], in->imm));
+            } else if (fitsImm16(in->imm)) {
+                emitWord(obj, encodeI(in->op == M_LW ? 0x23 : 0x2b, r[1], r[0], in->imm));
+            } else { // 偏移量超出16位时，先把基址加上高位部分放到$at中（低16位按有符号数补偿）
+                emitWord(obj, encodeI(0x0f, 0, 1, (unsigned)(in->imm + 0x8000) >> 16)); // LUI $at, 高16位
+                emitWord(obj, encodeR(1, r[1], 1, 0, 0x21)); // ADDU $at, $at, 基址
+                emitWord(obj, encodeI(in->op == M_LW ? 0x23 : 0x2b, 1, r[0], in->imm));
             }
-        } else { // 如果是其他情况，说明是语法错误（不应该出现）
-            error("Invalid quadruple");
+            break;
+        case M_LI:
+            encodeLoadImm(r[0], in->imm, obj);
+            break;
+        case M_MOVE:
+            emitWord(obj, encodeR(r[1], 0, r[0], 0, 0x21)); // ADDU rd, rs, $zero
+            break;
+        case M_ADDU:
+            emitWord(obj, encodeR(r[1], r[2], r[0], 0, 0x21));
+            break;
+        case M_SUBU:
+            emitWord(obj, encodeR(r[1], r[2], r[0], 0, 0x23));
+            break;
+        case M_MUL:
+            emitWord(obj, 0x1cu << 26 | encodeR(r[1], r[2], r[0], 0, 0x02)); // MIPS32的三操作数乘法（SPECIAL2）
+            break;
+        case M_DIV:
+        case M_REM:
+            emitWord(obj, encodeR(r[2], 0, 0, 7, 0x34)); // TEQ 除数, $zero, 7：除数为零时陷入
+            emitWord(obj, encodeR(r[1], r[2], 0, 0, 0x1a)); // DIV 被除数, 除数：商在LO中，余数在HI中
+            emitWord(obj, encodeR(0, 0, r[0], 0, in->op == M_DIV ? 0x12 : 0x10)); // MFLO或MFHI
+            break;
+        case M_ADDIU:
+        case M_SLTI:
+        case M_SLTIU:
+            if (fitsImm16(in->imm)) {
+                emitWord(obj, encodeI(in->op == M_ADDIU ? 0x09 : in->op == M_SLTI ? 0x0a : 0x0b, r[1], r[0], in->imm));
+            } else { // 立即数超出16位时，先装入$at，再用对应的R型指令
+                encodeLoadImm(1, in->imm, obj);
+                emitWord(obj, encodeR(r[1], 1, r[0], 0, in->op == M_ADDIU ? 0x21 : in->op == M_SLTI ? 0x2a : 0x2b));
+            }
+            break;
+        case M_SLL:
+            emitWord(obj, encodeR(0, r[1], r[0], in->imm, 0x00));
+            break;
+        case M_SRL:
+            emitWord(obj, encodeR(0, r[1], r[0], in->imm, 0x02));
+            break;
+        case M_SRA:
+            emitWord(obj, encodeR(0, r[1], r[0], in->imm, 0x03));
+            break;
+        case M_TEQ:
+            emitWord(obj, encodeR(r[0], r[1], 0, 0, 0x34));
+            break;
+        case M_BEQ:
+            encodeBranch(0x04, r[0], r[1], in->target, pos, obj);
+            break;
+        case M_BNE:
+            encodeBranch(0x05, r[0], r[1], in->target, pos, obj);
+            break;
+        case M_BLT: // rs < rt：SLT $at, rs, rt; BNE $at, $zero
+            emitWord(obj, encodeR(r[0], r[1], 1, 0, 0x2a));
+            encodeBranch(0x05, 1, 0, in->target, pos, obj);
+            break;
+        case M_BGE: // rs >= rt：SLT $at, rs, rt; BEQ $at, $zero
+            emitWord(obj, encodeR(r[0], r[1], 1, 0, 0x2a));
+            encodeBranch(0x04, 1, 0, in->target, pos, obj);
+            break;
+        case M_BGT: // rs > rt：SLT $at, rt, rs; BNE $at, $zero
+            emitWord(obj, encodeR(r[1], r[0], 1, 0, 0x2a));
+            encodeBranch(0x05, 1, 0, in->target, pos, obj);
+            break;
+        case M_BLE: // rs <= rt：SLT $at, rt, rs; BEQ $at, $zero
+            emitWord(obj, encodeR(r[1], r[0], 1, 0, 0x2a));
+            encodeBranch(0x04, 1, 0, in->target, pos, obj);
+            break;
+        case M_J:
+        case M_JAL:
+            if (pos != NULL) { // 跳转目标的绝对地址在链接时才能确定，生成一个引用目标标号的R_MIPS_26重定位项
+                addReloc(obj, R_MIPS_26, symbols[in->ref]);
+            }
+            emitWord(obj, (in->op == M_J ? 0x02u : 0x03u) << 26); // 目标字段为0，由重定位填写
+            emitWord(obj, 0); // 延迟槽：NOP
+            break;
+        case M_JR:
+            emitWord(obj, encodeR(r[0], 0, 0, 0, 0x08));
+            emitWord(obj, 0); // 延迟槽：NOP
+            break;
+        default:
+            break;
+    }
+}
+
+// 为代码段中下一个机器指令字登记一个重定位项
+void addReloc(struct ObjectCode *obj, int type, int symbol) {
+    if (obj->relocnum == obj->reloccap) { // 如果重定位表已满，容量翻倍
+        obj->reloccap = obj->reloccap ? obj->reloccap * 2 : LABELNUM;
+        obj->relocs = (struct Reloc *)realloc(obj->relocs, obj->reloccap * sizeof(struct Reloc));
+        if (obj->relocs == NULL) { // 如果分配失败，报错并退出程序
+            error("Out of memory");
         }
     }
-    fclose(fp); // 关闭目标代码文件
+    obj->relocs[obj->relocnum].type = type;
+    obj->relocs[obj->relocnum].offset = obj->num * 4;
+    obj->relocs[obj->relocnum].symbol = symbol;
+    obj->relocnum++;
 }
 
+// 写一个ELF32节头
+void bufSection(struct CodeBuffer *buf, int name, int type, int flags, int offset, int size, int link, int info, int align, int entsize) {
+    bufWord(buf, name);
+    bufWord(buf, type);
+    bufWord(buf, flags);
+    bufWord(buf, 0); // 可重定位目标文件中的节没有装入地址
+    bufWord(buf, offset);
+    bufWord(buf, size);
+    bufWord(buf, link);
+    bufWord(buf, info);
+    bufWord(buf, align);
+    bufWord(buf, entsize);
+}
+
+// 写一个ELF32符号表项，size为符号大小（0表示未知），shndx为符号所在节的序号
+void bufSymbol(struct CodeBuffer *buf, int name, int value, int size, int bind, int type, int shndx) {
+    bufWord(buf, name);
+    bufWord(buf, value);
+    bufWord(buf, size);
+    unsigned char info[2] = {ELF32_ST_INFO(bind, type), STV_DEFAULT};
+    bufBytes(buf, info, 2);
+    bufHalf(buf, shndx);
+}
+
+// 把目标程序编码为MIPS32机器指令（大端），写出可重定位的ELF32目标文件：
+// 代码段.text（节序号1）、重定位表.rel.text（J和JAL的R_MIPS_26，访问全局数据区的LW和SW的R_MIPS_GPREL16）、
+// 符号表.symtab（标号和全局数据区__data为局部符号，函数和顶层代码入口__toplevel为全局符号）、全局数据区.sbss（节序号6，不占文件空间）
+void writeObject(const char *path, struct Program *prog) {
+    if (offset > 32768) { // 全局数据区必须能用$gp加16位偏移量寻址
+        error("Static data too large for the small data section");
+    }
+    struct ObjectCode obj = {NULL, 0, 0, NULL, 0, 0, 2}; // 全局数据区符号紧跟在代码段的节符号之后
+    int *pos = (int *)malloc((prog->num + 1) * sizeof(int)); // 各条指令展开后的字地址
+    int *symbols = (int *)malloc((prog->labelnum + 1) * sizeof(int)); // 各标号在符号表中的序号
+    if (pos == NULL || symbols == NULL) { // 如果分配失败，报错并退出程序
+        error("Out of memory");
+    }
+    for (int i = 0; i < prog->num; i++) { // 第一遍：伪指令展开后的长度只取决于指令本身，据此确定各条指令的地址
+        pos[i] = obj.num;
+        encodeInstr(prog, i, NULL, NULL, &obj);
+    }
+    pos[prog->num] = obj.num;
+
+    for (int k = 0; k < prog->labelnum; k++) { // 先把所有标号标记为局部符号
+        symbols[k] = 0;
+    }
+    for (int k = 0; k < prog->labelnum; k++) { // 函数名是全局符号
+        int index = lookupSymbol(prog->labels[k].name);
+        if (index != -1 && symtab[index].kind == SYM_FUNC) {
+            symbols[k] = -1;
+        }
+    }
+    struct CodeBuffer symbuf = {NULL, 0, 0}; // 符号表
+    struct CodeBuffer strbuf = {NULL, 0, 0}; // 符号名字符串表
+    bufBytes(&strbuf, "", 1);
+    bufSymbol(&symbuf, 0, 0, 0, STB_LOCAL, STT_NOTYPE, SHN_UNDEF); // 第0项为空符号
+    bufSymbol(&symbuf, 0, 0, 0, STB_LOCAL, STT_SECTION, 1); // 第1项为代码段的节符号
+    bufSymbol(&symbuf, strbuf.len, 0, offset, STB_LOCAL, STT_OBJECT, 6); // 第2项为全局数据区，从.sbss开头开始
+    bufBytes(&strbuf, "__data", strlen("__data") + 1);
+    int nsyms = 3; // 符号个数
+    for (int k = 0; k < prog->labelnum; k++) { // ELF要求局部符号在全局符号之前
+        if (symbols[k] == 0) {
+            bufSymbol(&symbuf, strbuf.len, pos[prog->labels[k].quadpos] * 4, 0, STB_LOCAL, STT_NOTYPE, 1);
+            bufBytes(&strbuf, prog->labels[k].name, strlen(prog->labels[k].name) + 1);
+            symbols[k] = nsyms++;
+        }
+    }
+    int firstGlobal = nsyms; // 第一个全局符号的序号
+    bufSymbol(&symbuf, strbuf.len, 0, 0, STB_GLOBAL, STT_FUNC, 1); // 顶层代码从代码段开头开始
+    bufBytes(&strbuf, "__toplevel", strlen("__toplevel") + 1);
+    nsyms++;
+    for (int k = 0; k < prog->labelnum; k++) {
+        if (symbols[k] == -1) {
+            bufSymbol(&symbuf, strbuf.len, pos[prog->labels[k].quadpos] * 4, 0, STB_GLOBAL, STT_FUNC, 1);
+            bufBytes(&strbuf, prog->labels[k].name, strlen(prog->labels[k].name) + 1);
+            symbols[k] = nsyms++;
+        }
+    }
+
+    obj.num = 0;
+    for (int i = 0; i < prog->num; i++) { // 第二遍：地址已知，生成机器指令和重定位项
+        encodeInstr(prog, i, pos, symbols, &obj);
+    }
+
+    struct CodeBuffer text = {NULL, 0, 0}; // 代码段
+    for (int i = 0; i < obj.num; i++) {
+        bufWord(&text, obj.words[i]);
+    }
+    struct CodeBuffer rel = {NULL, 0, 0}; // 重定位表
+    for (int k = 0; k < obj.relocnum; k++) {
+        bufWord(&rel, obj.relocs[k].offset);
+        bufWord(&rel, ELF32_R_INFO(obj.relocs[k].symbol, obj.relocs[k].type));
+    }
+    struct CodeBuffer shstr = {NULL, 0, 0}; // 节名字符串表
+    const char *names[] = {"", ".text", ".rel.text", ".symtab", ".strtab", ".shstrtab", ".sbss"};
+    int nameoff[7]; // 各节名在节名字符串表中的偏移量
+    for (int s = 0; s < 7; s++) {
+        nameoff[s] = shstr.len;
+        bufBytes(&shstr, names[s], strlen(names[s]) + 1);
+    }
+
+    int textoff = 52; // 各节在文件中的偏移量，紧跟在ELF头之后依次存放
+    int reloff = textoff + text.len;
+    int symoff = reloff + rel.len;
+    int stroff = symoff + symbuf.len;
+    int shstroff = stroff + strbuf.len;
+    int shoff = (shstroff + shstr.len + 3) / 4 * 4; // 节头表按4字节对齐
+    struct CodeBuffer out = {NULL, 0, 0}; // 目标文件内容
+    unsigned char ident[EI_NIDENT] = {ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3, ELFCLASS32, ELFDATA2MSB, EV_CURRENT};
+    bufBytes(&out, ident, EI_NIDENT);
+    bufHalf(&out, ET_REL);
+    bufHalf(&out, EM_MIPS);
+    bufWord(&out, EV_CURRENT);
+    bufWord(&out, 0); // 没有入口地址
+    bufWord(&out, 0); // 没有程序头表
+    bufWord(&out, shoff);
+    bufWord(&out, EF_MIPS_ARCH_32 | EF_MIPS_NOREORDER); // MIPS32指令集，延迟槽已由编译器填写
+    bufHalf(&out, 52); // ELF头大小
+    bufHalf(&out, 0);
+    bufHalf(&out, 0);
+    bufHalf(&out, 40); // 节头大小
+    bufHalf(&out, 7); // 节个数
+    bufHalf(&out, 5); // 节名字符串表的节序号
+    bufBytes(&out, text.data, text.len);
+    bufBytes(&out, rel.data, rel.len);
+    bufBytes(&out, symbuf.data, symbuf.len);
+    bufBytes(&out, strbuf.data, strbuf.len);
+    bufBytes(&out, shstr.data, shstr.len);
+    while (out.len < shoff) {
+        bufBytes(&out, "", 1);
+    }
+    bufSection(&out, 0, SHT_NULL, 0, 0, 0, 0, 0, 0, 0);
+    bufSection(&out, nameoff[1], SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, textoff, text.len, 0, 0, 4, 0);
+    bufSection(&out, nameoff[2], SHT_REL, SHF_INFO_LINK, reloff, rel.len, 3, 1, 4, 8);
+    bufSection(&out, nameoff[3], SHT_SYMTAB, 0, symoff, symbuf.len, 4, firstGlobal, 4, 16);
+    bufSection(&out, nameoff[4], SHT_STRTAB, 0, stroff, strbuf.len, 0, 0, 1, 0);
+    bufSection(&out, nameoff[5], SHT_STRTAB, 0, shstroff, shstr.len, 0, 0, 1, 0);
+    bufSection(&out, nameoff[6], SHT_NOBITS, SHF_WRITE | SHF_ALLOC | SHF_MIPS_GPREL, shoff, offset, 0, 0, 4, 0); // 全局数据区由装入程序清零
+
+    FILE *fo = fopen(path, "wb"); // 打开目标文件
+    if (fo == NULL) { // 如果打开失败，报错并退出程序
+        error("Cannot open object file");
+    }
+    fwrite(out.data, 1, out.len, fo);
+    fclose(fo);
+    free(out.data);
+    free(text.data);
+    free(rel.data);
+    free(symbuf.data);
+    free(strbuf.data);
+    free(shstr.data);
+    free(obj.words);
+    free(obj.relocs);
+    free(pos);
+    free(symbols);
+}
 
 // 主函数，打开源程序文件并调用词法分析、语法分析、语义分析和目标代码生成函数
 int main(int argc, char *argv[]) {
-    if (argc < 2) { // 如果没有指定源程序文件名，报错并退出程序
+    char *source = NULL; // 源程序文件名
+    for (int i = 1; i < argc; i++) { // 解析命令行参数
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) { // -j N：使用N个线程并行生成目标代码
+            codegenThreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-lexj") == 0 && i + 1 < argc) { // -lexj N：预先分词，并用N个线程分块并行分词
+            lexThreads = atoi(argv[++i]);
+            pretokenized = 1;
+        } else if (strcmp(argv[i], "-pretok") == 0) { // -pretok：预先把整个源程序分词为结构数组形式的记号流，语法分析器只比较整数子类别
+            pretokenized = 1;
+        } else if (strcmp(argv[i], "-noinline") == 0) { // -noinline：不内联展开函数调用（同-skip inline）
+            passes[findPass("inline")].disabled = 1;
+        } else if (argv[i][0] == '-' && argv[i][1] == 'O') { // -O0、-O1、-O2：优化级别，只运行级别不高于它的优化遍
+            if (argv[i][2] < '0' || argv[i][2] > '2' || argv[i][3] != '\0') {
+                error("Invalid optimization level");
+            }
+            optLevel = argv[i][2] - '0';
+        } else if (strcmp(argv[i], "-skip") == 0 && i + 1 < argc) { // -skip P：关闭名为P的优化遍
+            passes[findPass(argv[++i])].disabled = 1;
+        } else if (strcmp(argv[i], "-dump-before") == 0 && i + 1 < argc) { // -dump-before P：在优化遍P运行前打印四元式序列
+            passes[findPass(argv[++i])].dumpBefore = 1;
+        } else if (strcmp(argv[i], "-dump-after") == 0 && i + 1 < argc) { // -dump-after P：在优化遍P运行后打印四元式序列
+            passes[findPass(argv[++i])].dumpAfter = 1;
+        } else if (strcmp(argv[i], "-time-passes") == 0) { // -time-passes：结束时打印各优化遍的运行时间和改动次数，以及各编译阶段的运行时间
+            timePasses = 1;
+        } else if (strcmp(argv[i], "-stats") == 0) { // -stats：结束时打印目标代码的静态指令数、栈帧大小和全局数据区大小
+            showStats = 1;
+        } else if (strcmp(argv[i], "-run") == 0) { // -run：模拟执行目标代码，打印动态指令数和返回值
+            runTarget = 1;
+        } else if (strcmp(argv[i], "-elf") == 0) { // -elf：把目标代码编码为机器指令，输出可重定位的ELF目标文件target.o
+            emitObject = 1;
+        } else if (strcmp(argv[i], "-listing") == 0) { // -listing：输出目标文件时同时输出汇编形式的目标代码target.txt
+            keepListing = 1;
+        } else if (strcmp(argv[i], "-stream") == 0) { // -stream：流式模式，边分析边输出目标代码，内存占用不随源程序增长
+            streaming = 1;
+        } else {
+            source = argv[i];
+        }
+    }
+    if (source == NULL) { // 如果没有指定源程序文件名，报错并退出程序
         error("Missing source file name");
     }
-    fp = fopen(argv[1], "r"); // 打开源程序文件
+    if (!emitObject) { // 不输出目标文件时，汇编形式的目标代码就是编译结果
+        keepListing = 1;
+    }
+    fp = fopen(source, "r"); // 打开源程序文件
     if (fp == NULL) { // 如果打开失败，报错并退出程序
         error("Cannot open source file");
     }
-    syntaxAnalysis(); // 调用语法分析函数，分析源程序的语法结构并生成四元式序列
-    semanticAnalysis(); // 调用语义分析函数，检查源程序的语义正确性并填充符号表和四元式序列中的值和地址信息
-    codeGeneration(); // 调用目标代码生成函数，根据四元式序列和符号表生成目标代码并输出到文件中
+    double start = wallTime(); // 当前阶段的开始时间
+    if (pretokenized) { // 预先分词模式：一次性读入并分词整个源程序
+        int size = 0; // 源程序长度
+        char *src = readSource(fp, &size);
+        lexParallel(src, size, lexThreads); // 分词线程数为1时串行分词
+        free(src); // 记号流只保存位置、长度和驻留编号，不再需要源程序文本
+        stageSeconds[ST_LEX] += wallTime() - start;
+        start = wallTime();
+    }
+    if (streaming) { // 流式模式：语法分析过程中每条顶层语句结束后即进行语义分析和代码生成
+        if (keepListing) {
+            streamOut = fopen("target.txt", "w"); // 打开目标代码文件
+            if (streamOut == NULL) { // 如果打开失败，报错并退出程序
+                error("Cannot open target file");
+            }
+        }
+        syntaxAnalysis(); // 调用语法分析函数，窗口满时自动输出
+        flushQuads(1); // 输出窗口中剩余的四元式
+        if (streamOut != NULL) {
+            fclose(streamOut); // 关闭目标代码文件
+        }
+        stageSeconds[ST_PARSE] += wallTime() - start; // flushQuads已减去输出窗口的时间
+    } else {
+        syntaxAnalysis(); // 调用语法分析函数，分析源程序的语法结构并生成四元式序列
+        stageSeconds[ST_PARSE] += wallTime() - start;
+        runPasses(); // 对四元式序列运行优化遍（各优化遍单独计时）
+        start = wallTime();
+        semanticAnalysis(); // 调用语义分析函数，检查源程序的语义正确性并填充符号表和四元式序列中的值和地址信息
+        stageSeconds[ST_SEMA] += wallTime() - start;
+        start = wallTime();
+        codeGeneration(); // 调用目标代码生成函数，根据四元式序列和符号表生成目标程序
+        stageSeconds[ST_CODEGEN] += wallTime() - start;
+    }
     fclose(fp); // 关闭源程序文件
+    if (showStats || runTarget || emitObject) { // 统计代码质量（输出到标准错误，每行为“类别 键=值 …”形式，便于脚本解析）、模拟执行或编码为目标文件
+        resolveLabels(&target);
+        if (showStats) {
+            fprintf(stderr, "stats static=%d frame=%d data=%d\n", target.num, totalFrameSize(), offset);
+        }
+        if (runTarget) {
+            int result; // 程序的返回值
+            long long steps = simulate(&target, offset, &result);
+            fprintf(stderr, "run dynamic=%lld result=%d\n", steps, result);
+        }
+        if (emitObject) {
+            start = wallTime();
+            writeObject("target.o", &target);
+            stageSeconds[ST_OBJECT] += wallTime() - start;
+        }
+    }
+    free(target.code);
+    free(target.labels);
+    if (timePasses) { // 打印各优化遍和各编译阶段的运行时间
+        printPassTimes();
+    }
     return 0;
 }
 
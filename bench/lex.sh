@@ -0,0 +1,56 @@
+#!/bin/sh
+# 并行分词的一致性和计时基准：生成一个大的源程序，分别用串行预先分词（-pretok）和N个线程并行分词（-lexj N）编译，
+# 检查输出的记号序列和目标代码与串行分词逐字节相同，并打印-time-passes统计的分词阶段时间
+# 用法：sh bench/lex.sh [-size MB] [-threads "N ..."]
+#   -size MB         生成的源程序大小（默认为16）
+#   -threads "N ..." 要比较的分词线程数（默认为"2 4 8"）
+# 记号序列或目标代码与串行分词不同时失败；加速比取决于机器的核数（同时打印nproc）
+
+set -e
+
+dir=$(cd "$(dirname "$0")" && pwd) # bench目录
+root=$(dirname "$dir") # 仓库根目录
+size=16
+threads="2 4 8"
+while [ $# -gt 0 ]; do
+    case "$1" in
+        -size) shift; size=$1 ;;
+        -threads) shift; threads=$1 ;;
+        *) echo "usage: $0 [-size MB] [-threads \"N ...\"]" >&2; exit 2 ;;
+    esac
+    shift
+done
+
+work=$(mktemp -d) # 编译器、源程序和输出放在临时目录中
+trap 'rm -rf "$work"' EXIT
+${CC:-gcc} -O2 -pthread -o "$work/cc" "$root/Conversation.c"
+
+# 生成源程序：声明若干全局变量，然后是简单的赋值语句，标识符和数字常量足够多，使各块的驻留表有大量重叠和各自首次出现的名字
+awk -v bytes=$((size * 1024 * 1024)) 'BEGIN {
+    nvars = 4096
+    for (i = 0; i < nvars; i++) { line = "int v" i ";"; print line; n += length(line) + 1 }
+    srand(1)
+    while (n < bytes) {
+        line = sprintf("v%d = v%d + %d * (v%d - %d);", int(rand() * nvars), int(rand() * nvars), int(rand() * 100000), int(rand() * nvars), int(rand() * 1000))
+        print line
+        n += length(line) + 1
+    }
+    print "return (v0);"
+}' > "$work/big.txt"
+
+echo "source $(wc -c < "$work/big.txt") bytes, nproc $(nproc 2>/dev/null || echo unknown)"
+lexTime() { # 从-time-passes的输出中取出分词阶段的时间（毫秒）
+    awk '$1 == "lex" { print $2 }' "$1"
+}
+(cd "$work" && ./cc -pretok -time-passes big.txt > tokens.1 2> time.1 && mv target.txt target.1)
+printf "%-8s %10s\n" "threads" "lex(ms)"
+printf "%-8s %10s\n" 1 "$(lexTime "$work/time.1")"
+fail=0
+for n in $threads; do
+    (cd "$work" && ./cc -lexj "$n" -time-passes big.txt > tokens.n 2> time.n)
+    status=""
+    if ! cmp -s "$work/tokens.1" "$work/tokens.n"; then status=" TOKENS DIFFER"; fail=1; fi
+    if ! cmp -s "$work/target.1" "$work/target.txt"; then status="$status TARGET DIFFERS"; fail=1; fi
+    printf "%-8s %10s%s\n" "$n" "$(lexTime "$work/time.n")" "$status"
+done
+exit $fail
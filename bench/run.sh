@@ -0,0 +1,72 @@
+#!/bin/sh
+# 代码质量回归基准：在-O0、-O1、-O2下编译bench/corpus中的每个程序，记录静态指令数、栈帧大小、全局数据区大小，
+# 以及模拟执行的动态指令数和返回值，并与基线bench/baseline.txt比较
+# 用法：sh bench/run.sh [-update] [-threshold N]
+#   -update        用本次结果覆盖基线
+#   -threshold N   静态指令数、栈帧大小、全局数据区大小或动态指令数比基线增加超过N%时失败（默认为2）
+# 返回值与基线不同时总是失败（说明生成的代码有错）
+
+set -e
+
+dir=$(cd "$(dirname "$0")" && pwd) # bench目录
+root=$(dirname "$dir") # 仓库根目录
+update=0
+threshold=2
+while [ $# -gt 0 ]; do
+    case "$1" in
+        -update) update=1 ;;
+        -threshold) shift; threshold=$1 ;;
+        *) echo "usage: $0 [-update] [-threshold N]" >&2; exit 2 ;;
+    esac
+    shift
+done
+
+work=$(mktemp -d) # 编译器和目标代码放在临时目录中
+trap 'rm -rf "$work"' EXIT
+${CC:-gcc} -O2 -pthread -o "$work/cc" "$root/Conversation.c"
+
+results="$work/results.txt"
+echo "# program level static frame data dynamic result" > "$results"
+for prog in "$dir"/corpus/*.txt; do
+    name=$(basename "$prog")
+    for level in 0 1 2; do
+        if ! (cd "$work" && ./cc -O$level -stats -run "$prog" > out.txt 2> stats.txt); then
+            echo "FAIL $name -O$level: $(tail -n 1 "$work/out.txt")" >&2
+            exit 1
+        fi
+        awk -v name="$name" -v level="$level" '
+            { for (i = 2; i <= NF; i++) { split($i, kv, "="); v[kv[1]] = kv[2] } }
+            END { print name, level, v["static"], v["frame"], v["data"], v["dynamic"], v["result"] }
+        ' "$work/stats.txt" >> "$results"
+    done
+done
+
+if [ "$update" = 1 ]; then
+    cp "$results" "$dir/baseline.txt"
+    echo "baseline updated"
+    exit 0
+fi
+if [ ! -f "$dir/baseline.txt" ]; then
+    echo "no baseline, run with -update first" >&2
+    exit 1
+fi
+
+# 按（程序, 优化级别）对照基线，逐项打印变化，超过阈值或返回值不同时失败
+awk -v th="$threshold" '
+    /^#/ { next }
+    FNR == NR { base[$1 " " $2] = $0; next }
+    {
+        key = $1 " " $2
+        if (!(key in base)) { printf "%-12s -O%s new\n", $1, $2; next }
+        split(base[key], b, " ")
+        line = sprintf("%-12s -O%s", $1, $2)
+        split("static frame data dynamic", names, " ")
+        for (i = 3; i <= 6; i++) {
+            line = line sprintf("  %s %d->%d", names[i - 2], b[i], $i)
+            if ($i > b[i] * (1 + th / 100)) { line = line " REGRESSION"; fail = 1 }
+        }
+        if ($7 != b[7]) { line = line sprintf("  result %s->%s WRONG", b[7], $7); fail = 1 }
+        print line
+    }
+    END { exit fail }
+' "$dir/baseline.txt" "$results"